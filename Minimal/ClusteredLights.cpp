@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "ClusteredLights.h"
+#include "GLState.h"
+
+const float ClusteredLights::CUTOFF = 1.0f / 256.0f;
+
+// Texture units used by the CLUSTERED shader variant; unit 0 stays free for material textures
+static const int LIGHT_UNIT = 1;
+static const int CLUSTER_UNIT = 2;
+static const int INDEX_UNIT = 3;
+
+ClusteredLights::ClusteredLights()
+{
+	glGenBuffers(1, &lightBuffer);
+	glGenBuffers(1, &clusterBuffer);
+	glGenBuffers(1, &indexBuffer);
+	glGenTextures(1, &lightTexture);
+	glGenTextures(1, &clusterTexture);
+	glGenTextures(1, &indexTexture);
+	binned.resize(GRID_X * GRID_Y * GRID_Z);
+	nearPlane = 0.01f;
+	farPlane = 1000.0f;
+	for (int i = 0; i < 4; i++)
+		viewport[i] = 0;
+}
+
+ClusteredLights::~ClusteredLights()
+{
+	glDeleteTextures(1, &lightTexture);
+	glDeleteTextures(1, &clusterTexture);
+	glDeleteTextures(1, &indexTexture);
+	glDeleteBuffers(1, &lightBuffer);
+	glDeleteBuffers(1, &clusterBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	GLState::invalidate();
+}
+
+float ClusteredLights::range(const PointLight& light)
+{
+	// Solve intensity / (constant + linear * d + quadratic * d^2) = CUTOFF for d
+	float intensity = std::max(std::max(light.diffuse.x, light.diffuse.y), light.diffuse.z);
+	intensity = std::max(intensity, std::max(std::max(light.specular.x, light.specular.y), light.specular.z));
+	float c = light.constant - intensity / CUTOFF;
+	if (c >= 0.0f) return 0.0f;
+	if (light.quadratic <= 0.0f) return light.linear > 0.0f ? -c / light.linear : FLT_MAX;
+	return (-light.linear + sqrtf(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+void ClusteredLights::update(glm::mat4 P, glm::mat4 V, float nearPlane, float farPlane)
+{
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	for (size_t c = 0; c < binned.size(); c++)
+		binned[c].clear();
+	lightData.clear();
+
+	float logDepth = logf(farPlane / nearPlane);
+	for (size_t i = 0; i < lights.size(); i++) {
+		const PointLight& light = lights[i];
+		glm::vec3 center = glm::vec3(V * glm::vec4(light.position, 1.0f));
+		float radius = range(light);
+
+		// Lights are stored in view space, four texels each
+		GLfloat data[16] = {
+			center.x, center.y, center.z, light.constant,
+			light.ambient.x, light.ambient.y, light.ambient.z, light.linear,
+			light.diffuse.x, light.diffuse.y, light.diffuse.z, light.quadratic,
+			light.specular.x, light.specular.y, light.specular.z, radius
+		};
+		lightData.insert(lightData.end(), data, data + 16);
+
+		// Depth slices covered by the light's sphere
+		float zNear = std::max(-center.z - radius, nearPlane);
+		float zFar = std::min(-center.z + radius, farPlane);
+		if (zNear > zFar) continue;
+		int z0 = (int)(logf(zNear / nearPlane) / logDepth * GRID_Z);
+		int z1 = (int)(logf(zFar / nearPlane) / logDepth * GRID_Z);
+		z0 = std::max(0, std::min(GRID_Z - 1, z0));
+		z1 = std::max(0, std::min(GRID_Z - 1, z1));
+
+		// Screen tiles covered by the sphere's view-space bounding box, projected at both ends of its depth range
+		float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f;
+		float depths[2] = { zNear, zFar };
+		for (int d = 0; d < 2; d++) {
+			for (int corner = 0; corner < 4; corner++) {
+				glm::vec4 p(center.x + ((corner & 1) ? radius : -radius), center.y + ((corner & 2) ? radius : -radius), -depths[d], 1.0f);
+				glm::vec4 clip = P * p;
+				float x = clip.x / clip.w;
+				float y = clip.y / clip.w;
+				minX = std::min(minX, x);
+				maxX = std::max(maxX, x);
+				minY = std::min(minY, y);
+				maxY = std::max(maxY, y);
+			}
+		}
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) continue;
+		int x0 = std::max(0, std::min(GRID_X - 1, (int)((minX * 0.5f + 0.5f) * GRID_X)));
+		int x1 = std::max(0, std::min(GRID_X - 1, (int)((maxX * 0.5f + 0.5f) * GRID_X)));
+		int y0 = std::max(0, std::min(GRID_Y - 1, (int)((minY * 0.5f + 0.5f) * GRID_Y)));
+		int y1 = std::max(0, std::min(GRID_Y - 1, (int)((maxY * 0.5f + 0.5f) * GRID_Y)));
+
+		for (int z = z0; z <= z1; z++)
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x++)
+					binned[(z * GRID_Y + y) * GRID_X + x].push_back((GLuint)i);
+	}
+
+	// Flatten into (offset, count) per froxel plus one shared index list
+	clusterData.resize(binned.size() * 2);
+	indexData.clear();
+	for (size_t c = 0; c < binned.size(); c++) {
+		clusterData[c * 2] = (GLuint)indexData.size();
+		clusterData[c * 2 + 1] = (GLuint)binned[c].size();
+		indexData.insert(indexData.end(), binned[c].begin(), binned[c].end());
+	}
+	if (lightData.empty()) lightData.resize(4, 0.0f);
+	if (indexData.empty()) indexData.push_back(0);
+
+	upload(lightBuffer, lightTexture, LIGHT_UNIT, GL_RGBA32F, &lightData[0], lightData.size() * sizeof(GLfloat));
+	upload(clusterBuffer, clusterTexture, CLUSTER_UNIT, GL_RG32UI, &clusterData[0], clusterData.size() * sizeof(GLuint));
+	upload(indexBuffer, indexTexture, INDEX_UNIT, GL_R32UI, &indexData[0], indexData.size() * sizeof(GLuint));
+}
+
+void ClusteredLights::upload(GLuint buffer, GLuint texture, GLuint unit, GLenum format, const void* data, size_t size)
+{
+	// Orphan the previous contents; each eye rewrites the buffers once per frame
+	GLState::bindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	// Attached on the unit bind() uses, so after the first frame this is no bind at all
+	GLState::bindTextureForUpdate(unit, GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+void ClusteredLights::bind(GLint shaderProgram)
+{
+	GLState::useProgram(shaderProgram);
+	GLState::bindTexture(LIGHT_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+	GLState::bindTexture(CLUSTER_UNIT, GL_TEXTURE_BUFFER, clusterTexture);
+	GLState::bindTexture(INDEX_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+
+	GLState::uniform1i("lightData", LIGHT_UNIT);
+	GLState::uniform1i("clusterData", CLUSTER_UNIT);
+	GLState::uniform1i("lightIndices", INDEX_UNIT);
+	GLState::uniform4f("viewportRect", (GLfloat)viewport[0], (GLfloat)viewport[1], (GLfloat)viewport[2], (GLfloat)viewport[3]);
+	GLState::uniform3i("clusterGrid", GRID_X, GRID_Y, GRID_Z);
+	GLState::uniform2f("clusterDepth", nearPlane, logf(farPlane / nearPlane));
+}
@@ -0,0 +1,59 @@
+#ifndef _CLUSTERED_LIGHTS_H_
+#define _CLUSTERED_LIGHTS_H_
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Same parameters as the PointLight struct in the fragment shaders
+struct PointLight {
+	glm::vec3 position; // world space
+	float constant;
+	float linear;
+	float quadratic;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+// Clustered forward lighting. Each eye's view frustum is split into a froxel grid (screen tiles
+// times exponential depth slices), every light is binned on the CPU into the froxels its range
+// touches, and the CLUSTERED variant of shader2.frag only evaluates the lights listed for its own froxel.
+// Light data, per-froxel ranges and the light index list are uploaded as buffer textures.
+class ClusteredLights
+{
+public:
+	static const int GRID_X = 16;
+	static const int GRID_Y = 8;
+	static const int GRID_Z = 24;
+	// Attenuated intensity below which a light no longer contributes
+	static const float CUTOFF;
+
+	ClusteredLights();
+	~ClusteredLights();
+
+	std::vector<PointLight> lights;
+
+	// Bins the lights for one eye and uploads the result. Call with that eye's viewport set.
+	void update(glm::mat4 P, glm::mat4 V, float nearPlane, float farPlane);
+	// Binds the buffer textures and grid uniforms to a ShaderCache::CLUSTERED program
+	void bind(GLint shaderProgram);
+
+	// Distance at which the light's attenuated intensity drops below CUTOFF
+	static float range(const PointLight& light);
+
+private:
+	GLuint lightBuffer, lightTexture;
+	GLuint clusterBuffer, clusterTexture;
+	GLuint indexBuffer, indexTexture;
+	std::vector<GLfloat> lightData;
+	std::vector<GLuint> clusterData;
+	std::vector<GLuint> indexData;
+	std::vector<std::vector<GLuint> > binned;
+	GLint viewport[4];
+	float nearPlane, farPlane;
+
+	static void upload(GLuint buffer, GLuint texture, GLuint unit, GLenum format, const void* data, size_t size);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <iostream>
+#include <Windows.h>
+#include "FramePacer.h"
+
+const double FramePacer::COMPOSITOR_MS = 2.0;
+const double FramePacer::MIN_MARGIN_MS = 1.0;
+const double FramePacer::MAX_MARGIN_MS = 6.0;
+
+FramePacer::FramePacer()
+{
+	enabled = true;
+	reporting = false;
+	interval = 1.0 / 90.0;
+	start = deadline = 0.0;
+	cpuEstimate = 0.0;
+	margin = 2.0;
+	started = false;
+	frames = late = 0;
+	waited = slack = 0.0;
+	minSlack = 1.0e9;
+	timerRaised = false;
+}
+
+FramePacer::~FramePacer()
+{
+	setTimer(false);
+}
+
+void FramePacer::setTimer(bool raise)
+{
+	if (raise == timerRaised) return;
+	// Sleep(1) otherwise lasts a whole 15.6 ms scheduler tick; the 1 ms period costs power system-wide, so
+	// it is only held while frames are being paced
+	if (raise) timeBeginPeriod(1);
+	else timeEndPeriod(1);
+	timerRaised = raise;
+}
+
+void FramePacer::idle()
+{
+	setTimer(false);
+}
+
+void FramePacer::setRefreshRate(float hz)
+{
+	interval = 1.0 / hz;
+}
+
+void FramePacer::beginFrame(ovrSession session, long long frameIndex, float gpuMilliseconds)
+{
+	double display = ovr_GetPredictedDisplayTime(session, frameIndex);
+	deadline = display - 0.5 * interval - (COMPOSITOR_MS + gpuMilliseconds) / 1000.0;
+	double target = deadline - cpuEstimate - margin / 1000.0;
+	double now = ovr_GetTimeInSeconds();
+	setTimer(enabled);
+	if (enabled && target > now) {
+		// Never hold a frame back by more than the largest margin, whatever the estimates say
+		target = std::min(target, now + MAX_MARGIN_MS / 1000.0);
+		// Coarse sleeps, then give the core away one time slice at a time for the last couple of milliseconds
+		while (target - ovr_GetTimeInSeconds() > 0.002)
+			Sleep(1);
+		while (ovr_GetTimeInSeconds() < target)
+			Sleep(0);
+		waited += ovr_GetTimeInSeconds() - now;
+	}
+	start = ovr_GetTimeInSeconds();
+	started = true;
+}
+
+void FramePacer::endFrame()
+{
+	if (!started) return;
+	started = false;
+	double now = ovr_GetTimeInSeconds();
+	double work = now - start;
+	// Up at once, down slowly, so one quick frame does not start the next one too late
+	cpuEstimate = work > cpuEstimate ? work : cpuEstimate * 0.95 + work * 0.05;
+
+	double frameSlack = (deadline - now) * 1000.0;
+	if (frameSlack < 0.0) {
+		late++;
+		margin = std::min(MAX_MARGIN_MS, margin + 1.0);
+	}
+	else if (frameSlack > margin + 1.0) {
+		margin = std::max(MIN_MARGIN_MS, margin - 0.02);
+	}
+	slack += frameSlack;
+	minSlack = std::min(minSlack, frameSlack);
+
+	if (++frames == REPORT_FRAMES) {
+		if (reporting)
+			std::cout << "Frame pacing " << (enabled ? "on" : "off") << ": slack " << slack / frames << " ms average, " << minSlack
+				<< " ms minimum, " << late << " late; waited " << waited * 1000.0 / frames << " ms per frame, CPU "
+				<< cpuEstimate * 1000.0 << " ms, margin " << margin << " ms" << std::endl;
+		frames = late = 0;
+		waited = slack = 0.0;
+		minSlack = 1.0e9;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef _FRAME_PACER_H_
+#define _FRAME_PACER_H_
+
+#include <OVR_CAPI.h>
+
+// Starts each frame's CPU work as late as the compositor deadline allows, so the simulation and the
+// poses it latches are as fresh as possible. The deadline comes from the frame's predicted display
+// time: half a refresh back to vsync, COMPOSITOR_MS for the compositor, then the GPU time of recent
+// frames. The frame starts the CPU time of recent frames plus a safety margin before that deadline.
+// The margin grows whenever a frame submits late and shrinks back slowly while there is slack.
+class FramePacer
+{
+public:
+	static const double COMPOSITOR_MS;
+	static const double MIN_MARGIN_MS;
+	// Also the most the pacer will ever wait; past this, pacing is left to ovr_SubmitFrame alone
+	static const double MAX_MARGIN_MS;
+	static const int REPORT_FRAMES = 90;
+
+	FramePacer();
+	~FramePacer();
+
+	bool enabled;
+	// Logs slack, waits and the margin every REPORT_FRAMES frames
+	bool reporting;
+
+	void setRefreshRate(float hz);
+	// Waits until it is time to start the frame; call before the frame's update
+	void beginFrame(ovrSession session, long long frameIndex, float gpuMilliseconds);
+	// Call instead of beginFrame while no frames are drawn, to release the raised timer resolution
+	void idle();
+	// Call right before ovr_SubmitFrame
+	void endFrame();
+
+private:
+	double interval;
+	double start, deadline;
+	double cpuEstimate;
+	double margin;
+	bool started;
+	// Whether this pacer holds timeBeginPeriod(1); only while enabled and drawing
+	bool timerRaised;
+
+	// Since the last report
+	int frames, late;
+	double waited, slack, minSlack;
+
+	void setTimer(bool raise);
+};
+
+#endif
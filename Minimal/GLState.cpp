@@ -0,0 +1,194 @@
+#include <cstring>
+#include "GLState.h"
+
+// Values no real binding can have, so the first call after invalidate() always goes through
+static const GLuint UNKNOWN = ~0u;
+
+unsigned int GLState::issued = 0;
+unsigned int GLState::elided = 0;
+
+GLuint GLState::program = UNKNOWN;
+GLuint GLState::vertexArray = UNKNOWN;
+GLint GLState::activeUnit = -1;
+GLfloat GLState::width = -1.0f;
+std::unordered_map<GLenum, GLuint> GLState::buffers;
+std::unordered_map<unsigned long long, GLuint> GLState::textures;
+std::unordered_map<GLenum, bool> GLState::capabilities;
+std::unordered_map<GLuint, GLState::UniformSlots> GLState::uniforms;
+GLState::UniformSlots* GLState::slots = nullptr;
+
+void GLState::useProgram(GLuint program)
+{
+	if (GLState::program == program) {
+		elided++;
+		return;
+	}
+	GLState::program = program;
+	slots = &uniforms[program];
+	glUseProgram(program);
+	issued++;
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+	if (vertexArray == vao) {
+		elided++;
+		return;
+	}
+	vertexArray = vao;
+	glBindVertexArray(vao);
+	issued++;
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+	if (target != GL_ELEMENT_ARRAY_BUFFER) {
+		auto found = buffers.find(target);
+		if (found != buffers.end() && found->second == buffer) {
+			elided++;
+			return;
+		}
+		buffers[target] = buffer;
+	}
+	glBindBuffer(target, buffer);
+	issued++;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	unsigned long long key = ((unsigned long long)unit << 32) | target;
+	auto found = textures.find(key);
+	if (found != textures.end() && found->second == texture) {
+		elided++;
+		return;
+	}
+	textures[key] = texture;
+	if (activeUnit != (GLint)unit) {
+		activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		issued++;
+	}
+	glBindTexture(target, texture);
+	issued++;
+}
+
+void GLState::bindTextureForUpdate(GLuint unit, GLenum target, GLuint texture)
+{
+	if (activeUnit != (GLint)unit) {
+		activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		issued++;
+	}
+	bindTexture(unit, target, texture);
+}
+
+void GLState::lineWidth(GLfloat width)
+{
+	if (GLState::width == width) {
+		elided++;
+		return;
+	}
+	GLState::width = width;
+	glLineWidth(width);
+	issued++;
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled)
+{
+	auto found = capabilities.find(capability);
+	if (found != capabilities.end() && found->second == enabled) {
+		elided++;
+		return;
+	}
+	capabilities[capability] = enabled;
+	if (enabled) glEnable(capability);
+	else glDisable(capability);
+	issued++;
+}
+
+GLint GLState::changed(const char* name, const void* value, GLsizei size)
+{
+	if (!slots) slots = &uniforms[program];
+	auto found = slots->find(name);
+	if (found == slots->end()) {
+		Uniform slot;
+		slot.location = glGetUniformLocation(program, name);
+		slot.size = 0;
+		found = slots->insert(std::make_pair(name, slot)).first;
+	}
+	Uniform& slot = found->second;
+	// Writes to uniforms the compiler removed are no-ops as well
+	if (slot.location < 0 || (slot.size == size && memcmp(slot.value, value, size) == 0)) {
+		elided++;
+		return -1;
+	}
+	memcpy(slot.value, value, size);
+	slot.size = size;
+	issued++;
+	return slot.location;
+}
+
+void GLState::uniform1i(const char* name, GLint value)
+{
+	GLint location = changed(name, &value, sizeof(value));
+	if (location >= 0) glUniform1i(location, value);
+}
+
+void GLState::uniform1f(const char* name, GLfloat value)
+{
+	GLint location = changed(name, &value, sizeof(value));
+	if (location >= 0) glUniform1f(location, value);
+}
+
+void GLState::uniform2f(const char* name, GLfloat x, GLfloat y)
+{
+	GLfloat value[2] = { x, y };
+	GLint location = changed(name, value, sizeof(value));
+	if (location >= 0) glUniform2f(location, x, y);
+}
+
+void GLState::uniform3f(const char* name, GLfloat x, GLfloat y, GLfloat z)
+{
+	GLfloat value[3] = { x, y, z };
+	GLint location = changed(name, value, sizeof(value));
+	if (location >= 0) glUniform3f(location, x, y, z);
+}
+
+void GLState::uniform3i(const char* name, GLint x, GLint y, GLint z)
+{
+	GLint value[3] = { x, y, z };
+	GLint location = changed(name, value, sizeof(value));
+	if (location >= 0) glUniform3i(location, x, y, z);
+}
+
+void GLState::uniform4f(const char* name, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+	GLfloat value[4] = { x, y, z, w };
+	GLint location = changed(name, value, sizeof(value));
+	if (location >= 0) glUniform4f(location, x, y, z, w);
+}
+
+void GLState::uniformMatrix4fv(const char* name, const GLfloat* value)
+{
+	GLint location = changed(name, value, 16 * sizeof(GLfloat));
+	if (location >= 0) glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+void GLState::invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	activeUnit = -1;
+	width = -1.0f;
+	buffers.clear();
+	textures.clear();
+	capabilities.clear();
+	uniforms.clear();
+	slots = nullptr;
+}
+
+void GLState::resetStats()
+{
+	issued = 0;
+	elided = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef _GL_STATE_H_
+#define _GL_STATE_H_
+
+#include <unordered_map>
+#include <GL/glew.h>
+
+// Shadow copy of the GL state the renderer touches. Draw code binds and writes uniforms through here,
+// and calls that would leave the state unchanged are skipped. Code that changes the same state directly
+// or deletes a bound object must call invalidate() afterwards.
+class GLState
+{
+public:
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vao);
+	// GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO and is always passed through
+	static void bindBuffer(GLenum target, GLuint buffer);
+	// Makes unit active only when the binding actually has to change, so it is only for sampling
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	// Same, but always leaves unit active, for raw glTex* calls on the texture that follow
+	static void bindTextureForUpdate(GLuint unit, GLenum target, GLuint texture);
+	static void lineWidth(GLfloat width);
+	static void setEnabled(GLenum capability, bool enabled);
+
+	// Uniforms of the current program by name; locations are looked up once per program
+	// and a write is skipped when the uniform already holds the value.
+	// Names are cached by address, so pass string literals or strings that outlive the program unchanged.
+	static void uniform1i(const char* name, GLint value);
+	static void uniform1f(const char* name, GLfloat value);
+	static void uniform2f(const char* name, GLfloat x, GLfloat y);
+	static void uniform3f(const char* name, GLfloat x, GLfloat y, GLfloat z);
+	static void uniform3i(const char* name, GLint x, GLint y, GLint z);
+	static void uniform4f(const char* name, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+	static void uniformMatrix4fv(const char* name, const GLfloat* value);
+
+	// Forgets everything, including cached uniform values; needed after deleting or relinking programs
+	static void invalidate();
+
+	// Calls passed on to GL and calls skipped since the last resetStats()
+	static unsigned int issued;
+	static unsigned int elided;
+	static void resetStats();
+
+private:
+	struct Uniform {
+		GLint location;
+		GLsizei size;
+		unsigned char value[16 * sizeof(GLfloat)];
+	};
+
+	static GLuint program;
+	static GLuint vertexArray;
+	static GLint activeUnit;
+	static GLfloat width;
+	static std::unordered_map<GLenum, GLuint> buffers;
+	// Keyed by unit and target
+	static std::unordered_map<unsigned long long, GLuint> textures;
+	static std::unordered_map<GLenum, bool> capabilities;
+	typedef std::unordered_map<const char*, Uniform> UniformSlots;
+	static std::unordered_map<GLuint, UniformSlots> uniforms;
+	// Slots of the current program, so a write does a single lookup
+	static UniformSlots* slots;
+
+	// Returns the location to write to, or -1 when the write can be skipped
+	static GLint changed(const char* name, const void* value, GLsizei size);
+};
+
+#endif
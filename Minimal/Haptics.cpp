@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "Haptics.h"
+
+const float Haptics::REFRESH = 2.0f;
+
+Haptics::Haptics()
+{
+	session = nullptr;
+	calls = 0;
+	for (int hand = 0; hand < HANDS; hand++) {
+		Motor& motor = motors[hand];
+		motor.controller = hand == ovrHand_Left ? ovrControllerType_LTouch : ovrControllerType_RTouch;
+		memset(&motor.desc, 0, sizeof(motor.desc));
+		motor.frequency = motor.amplitude = 0.0f;
+		motor.sentAt = 0.0;
+		motor.baseFrequency = motor.baseAmplitude = 0.0f;
+		motor.step = 0;
+		motor.stepEnd = 0.0;
+		motor.submitted = 0;
+		motor.bufferedEnd = 0.0;
+	}
+}
+
+void Haptics::init(ovrSession session)
+{
+	this->session = session;
+	for (int hand = 0; hand < HANDS; hand++) {
+		Motor& motor = motors[hand];
+		motor.desc = ovr_GetTouchHapticsDesc(session, motor.controller);
+		// The motor's state is unknown until the first call; make sure it starts off
+		ovr_SetControllerVibration(session, motor.controller, 0.0f, 0.0f);
+		calls++;
+	}
+	std::cout << "Haptics: " << motors[0].desc.SampleRateHz << " Hz, " << motors[0].desc.SampleSizeInBytes
+		<< " byte samples, " << motors[0].desc.SubmitMinSamples << " to " << motors[0].desc.SubmitMaxSamples << " per submit" << std::endl;
+}
+
+void Haptics::set(ovrHandType hand, float frequency, float amplitude)
+{
+	motors[hand].baseFrequency = frequency;
+	motors[hand].baseAmplitude = amplitude;
+}
+
+void Haptics::play(ovrHandType hand, const std::vector<HapticsPulse>& pattern)
+{
+	Motor& motor = motors[hand];
+	motor.pattern = pattern;
+	motor.step = 0;
+	motor.stepEnd = pattern.empty() ? 0.0 : ovr_GetTimeInSeconds() + pattern[0].seconds;
+}
+
+void Haptics::submit(ovrHandType hand, const std::vector<float>& amplitudes)
+{
+	Motor& motor = motors[hand];
+	int bytes = std::max(1, motor.desc.SampleSizeInBytes);
+	double scale = (double)((1ull << (8 * bytes)) - 1);
+	motor.samples.resize(amplitudes.size() * bytes);
+	for (size_t i = 0; i < amplitudes.size(); i++) {
+		unsigned long long value = (unsigned long long)(std::min(1.0f, std::max(0.0f, amplitudes[i])) * scale + 0.5);
+		for (int b = 0; b < bytes; b++)
+			motor.samples[i * bytes + b] = (unsigned char)(value >> (8 * b));
+	}
+	motor.submitted = 0;
+}
+
+std::vector<float> Haptics::fade(ovrHandType hand, float seconds, float peak) const
+{
+	int count = std::max(1, (int)(seconds * sampleRate(hand)));
+	std::vector<float> amplitudes(count);
+	for (int i = 0; i < count; i++)
+		amplitudes[i] = peak * (1.0f - (float)i / count);
+	return amplitudes;
+}
+
+void Haptics::send(Motor& motor, float frequency, float amplitude, double now)
+{
+	bool off = amplitude <= 0.0f || frequency <= 0.0f;
+	bool wasOff = motor.amplitude <= 0.0f || motor.frequency <= 0.0f;
+	if (off && wasOff) return;
+	if (!off && frequency == motor.frequency && amplitude == motor.amplitude && now - motor.sentAt < REFRESH) return;
+	ovr_SetControllerVibration(session, motor.controller, off ? 0.0f : frequency, off ? 0.0f : amplitude);
+	calls++;
+	motor.frequency = off ? 0.0f : frequency;
+	motor.amplitude = off ? 0.0f : amplitude;
+	motor.sentAt = now;
+}
+
+void Haptics::update()
+{
+	if (!session) return;
+	double now = ovr_GetTimeInSeconds();
+	for (int hand = 0; hand < HANDS; hand++) {
+		Motor& motor = motors[hand];
+
+		float frequency = motor.baseFrequency, amplitude = motor.baseAmplitude;
+		while (motor.step < motor.pattern.size() && now >= motor.stepEnd) {
+			if (++motor.step < motor.pattern.size()) motor.stepEnd += motor.pattern[motor.step].seconds;
+		}
+		if (motor.step < motor.pattern.size()) {
+			frequency = motor.pattern[motor.step].frequency;
+			amplitude = motor.pattern[motor.step].amplitude;
+		}
+		else if (!motor.pattern.empty()) {
+			motor.pattern.clear();
+		}
+
+		// Buffered and constant vibration do not mix, so the constant state is held off while samples play
+		int bytes = std::max(1, motor.desc.SampleSizeInBytes);
+		if (motor.submitted < motor.samples.size() || now < motor.bufferedEnd) {
+			send(motor, 0.0f, 0.0f, now);
+			if (motor.submitted < motor.samples.size()) {
+				ovrHapticsPlaybackState state;
+				calls++;
+				if (ovr_GetControllerVibrationState(session, motor.controller, &state) == ovrSuccess) {
+					int remaining = (int)((motor.samples.size() - motor.submitted) / bytes);
+					int count = std::min(std::min(remaining, state.RemainingQueueSpace), motor.desc.SubmitMaxSamples);
+					if (count > 0 && (count >= motor.desc.SubmitMinSamples || count == remaining)) {
+						ovrHapticsBuffer buffer;
+						buffer.Samples = &motor.samples[motor.submitted];
+						buffer.SamplesCount = count;
+						buffer.SubmitMode = ovrHapticsBufferSubmit_Enqueue;
+						ovr_SubmitControllerVibration(session, motor.controller, &buffer);
+						calls++;
+						motor.submitted += count * bytes;
+						motor.bufferedEnd = now + (double)(state.SamplesQueued + count) / std::max(1, motor.desc.SampleRateHz);
+					}
+				}
+				else {
+					// No Touch controller on this hand (ovrSuccess_DeviceUnavailable); drop the effect
+					motor.submitted = motor.samples.size();
+				}
+			}
+			if (motor.submitted >= motor.samples.size()) motor.samples.clear();
+			continue;
+		}
+		motor.submitted = 0;
+
+		send(motor, frequency, amplitude, now);
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef _HAPTICS_H_
+#define _HAPTICS_H_
+
+#include <vector>
+#include <OVR_CAPI.h>
+
+// One step of a timed vibration pattern
+struct HapticsPulse {
+	float seconds;
+	float frequency; // 0, 0.5 or 1, as for ovr_SetControllerVibration
+	float amplitude;
+};
+
+// Touch vibration for both hands. The state last sent to each motor is remembered and the runtime is
+// only called when it has to change (or to refresh a constant vibration before the runtime's 2.5 s
+// limit), so an idle motor costs nothing per frame. On top of the constant state, a hand can play a
+// timed pattern of constant steps, or a buffered effect: amplitude samples streamed through
+// ovr_SubmitControllerVibration at the controller's haptics sample rate.
+class Haptics
+{
+public:
+	static const int HANDS = 2;
+	// Seconds after which a constant vibration is sent again, inside the runtime's 2.5 s timeout
+	static const float REFRESH;
+
+	Haptics();
+
+	void init(ovrSession session);
+	// Constant vibration, kept until changed; patterns and buffered effects play over it
+	void set(ovrHandType hand, float frequency, float amplitude);
+	void play(ovrHandType hand, const std::vector<HapticsPulse>& pattern);
+	// Amplitudes from 0 to 1 at sampleRate(hand); replaces a buffered effect still playing
+	void submit(ovrHandType hand, const std::vector<float>& amplitudes);
+	int sampleRate(ovrHandType hand) const { return motors[hand].desc.SampleRateHz; }
+	// Amplitudes falling linearly from peak to 0 over the given time, ready for submit
+	std::vector<float> fade(ovrHandType hand, float seconds, float peak) const;
+	// Advances patterns and buffered effects; call once per frame
+	void update();
+
+	// Runtime calls made since the last resetStats()
+	unsigned int calls;
+	void resetStats() { calls = 0; }
+
+private:
+	struct Motor {
+		ovrControllerType controller;
+		ovrTouchHapticsDesc desc;
+		// What was last sent with ovr_SetControllerVibration, and when
+		float frequency, amplitude;
+		double sentAt;
+		float baseFrequency, baseAmplitude;
+		std::vector<HapticsPulse> pattern;
+		size_t step;
+		double stepEnd;
+		// Samples of the buffered effect not yet handed to the runtime
+		std::vector<unsigned char> samples;
+		size_t submitted;
+		double bufferedEnd;
+	};
+
+	ovrSession session;
+	Motor motors[HANDS];
+
+	void send(Motor& motor, float frequency, float amplitude, double now);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <cmath>
+#include <vector>
+#include "HiddenAreaMask.h"
+#include "ShaderCache.h"
+#include "GLState.h"
+
+// ovr_GetFovStencil only arrived in later SDKs, so the visible area comes from this table: the ellipse
+// through the FOV edges scaled by radius. Values are on the safe side; unknown headsets get a small mask.
+static const struct {
+	ovrHmdType type;
+	float radius;
+} VISIBLE_AREA[] = {
+	{ ovrHmd_CV1, 1.05f },
+	{ ovrHmd_DK2, 1.08f },
+};
+static const float DEFAULT_RADIUS = 1.15f;
+
+// The outer ring of the mask, as a multiple of the ellipse; far enough out to cover the viewport corners
+static const float OUTER = 4.0f;
+
+HiddenAreaMask::HiddenAreaMask()
+{
+	enabled = true;
+	VAO = 0;
+	VBO = 0;
+	covered[0] = covered[1] = 0.0f;
+}
+
+HiddenAreaMask::~HiddenAreaMask()
+{
+	if (!VAO) return;
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	GLState::invalidate();
+}
+
+float HiddenAreaMask::visibleRadius(ovrHmdType hmd)
+{
+	for (size_t i = 0; i < sizeof(VISIBLE_AREA) / sizeof(VISIBLE_AREA[0]); i++)
+		if (VISIBLE_AREA[i].type == hmd) return VISIBLE_AREA[i].radius;
+	return DEFAULT_RADIUS;
+}
+
+void HiddenAreaMask::init(ovrHmdType hmd, const ovrFovPort fov[2])
+{
+	float radius = visibleRadius(hmd);
+	std::vector<GLfloat> vertices;
+	for (int eye = 0; eye < 2; eye++) {
+		// Points on the ellipse, with the semi-axis on each side taken from that side's half-angle
+		std::vector<glm::vec2> ring(SEGMENTS + 1);
+		for (int i = 0; i <= SEGMENTS; i++) {
+			float angle = 2.0f * 3.14159265f * i / SEGMENTS;
+			float c = cosf(angle), s = sinf(angle);
+			ring[i] = glm::vec2(c * radius * (c >= 0.0f ? fov[eye].RightTan : fov[eye].LeftTan),
+				s * radius * (s >= 0.0f ? fov[eye].UpTan : fov[eye].DownTan));
+		}
+		for (int i = 0; i < SEGMENTS; i++) {
+			glm::vec2 quad[6] = { ring[i], ring[i] * OUTER, ring[i + 1], ring[i + 1], ring[i] * OUTER, ring[i + 1] * OUTER };
+			for (int v = 0; v < 6; v++) {
+				vertices.push_back(quad[v].x);
+				vertices.push_back(quad[v].y);
+			}
+		}
+
+		// The viewport is linear in tangent space, so a grid over the FOV gives the pixel fraction
+		const int GRID = 256;
+		int hidden = 0;
+		for (int y = 0; y < GRID; y++) {
+			for (int x = 0; x < GRID; x++) {
+				float tx = -fov[eye].LeftTan + (fov[eye].LeftTan + fov[eye].RightTan) * (x + 0.5f) / GRID;
+				float ty = -fov[eye].DownTan + (fov[eye].DownTan + fov[eye].UpTan) * (y + 0.5f) / GRID;
+				float ex = tx / (radius * (tx >= 0.0f ? fov[eye].RightTan : fov[eye].LeftTan));
+				float ey = ty / (radius * (ty >= 0.0f ? fov[eye].UpTan : fov[eye].DownTan));
+				if (ex * ex + ey * ey > 1.0f) hidden++;
+			}
+		}
+		covered[eye] = (float)hidden / (GRID * GRID);
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	GLState::bindVertexArray(VAO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
+}
+
+void HiddenAreaMask::draw(int eye, const glm::mat4& projection)
+{
+	if (!enabled || !VAO) return;
+	GLint program = ShaderCache::get("hidden.vert", "depth.frag");
+	if (!program) return;
+	GLState::useProgram(program);
+	GLState::uniformMatrix4fv("projection", &projection[0][0]);
+	GLState::bindVertexArray(VAO);
+	GLState::setEnabled(GL_CULL_FACE, false);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDrawArrays(GL_TRIANGLES, eye * SEGMENTS * 6, SEGMENTS * 6);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
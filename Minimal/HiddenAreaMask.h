@@ -0,0 +1,37 @@
+#ifndef _HIDDEN_AREA_MASK_H_
+#define _HIDDEN_AREA_MASK_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <OVR_CAPI.h>
+
+// Depth mask over the parts of each eye buffer that cannot be seen through the lens. The visible area
+// is modelled as an ellipse in tangent space, one semi-axis per ovrFovPort half-angle scaled by a
+// per-HMD factor; everything between it and the viewport edges is drawn at the near plane right
+// after the clear, so the scene's depth test rejects those pixels before they are shaded.
+class HiddenAreaMask
+{
+public:
+	// Segments around the visible ellipse
+	static const int SEGMENTS = 64;
+
+	HiddenAreaMask();
+	~HiddenAreaMask();
+
+	bool enabled;
+
+	void init(ovrHmdType hmd, const ovrFovPort fov[2]);
+	// Writes the eye's mask into the depth buffer over the current viewport; projection is the one the
+	// scene is about to be drawn with, which may cover only part of the eye's FOV
+	void draw(int eye, const glm::mat4& projection);
+	// Fraction of the eye's viewport the mask covers
+	float coverage(int eye) const { return covered[eye]; }
+
+private:
+	GLuint VAO, VBO;
+	float covered[2];
+
+	static float visibleRadius(ovrHmdType hmd);
+};
+
+#endif
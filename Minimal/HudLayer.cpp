@@ -0,0 +1,166 @@
+#include <cstring>
+#include <iostream>
+#include <OVR_CAPI_GL.h>
+#include "HudLayer.h"
+#include "GLState.h"
+
+static const int GLYPH_WIDTH = 5;
+static const int GLYPH_HEIGHT = 7;
+static const int MARGIN = 8;
+static const unsigned char BACKGROUND_ALPHA = 160;
+
+// Rows top to bottom, leftmost pixel in bit 4; characters not listed are drawn blank
+static const struct {
+	char c;
+	unsigned char rows[GLYPH_HEIGHT];
+} FONT[] = {
+	{ ' ', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+	{ '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+	{ '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+	{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+	{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+	{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+	{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+	{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+	{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+	{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+	{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+	{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+	{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+	{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+	{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+	{ ':', { 0x00, 0x04, 0x04, 0x00, 0x04, 0x04, 0x00 } },
+	{ 'A', { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+	{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+	{ 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+	{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+	{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+	{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+	{ 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+	{ 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+	{ 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+	{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+	{ 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+	{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+	{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+	{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+	{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+	{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+	{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+	{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+	{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+	{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+	{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+	{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+	{ 'Y', { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 } },
+	{ 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+};
+
+HudLayer::HudLayer()
+{
+	enabled = true;
+	session = nullptr;
+	chain = nullptr;
+	committed = false;
+	memset(&layer, 0, sizeof(layer));
+}
+
+void HudLayer::init(ovrSession session)
+{
+	this->session = session;
+	ovrTextureSwapChainDesc desc = {};
+	desc.Type = ovrTexture_2D;
+	desc.ArraySize = 1;
+	desc.Width = WIDTH;
+	desc.Height = HEIGHT;
+	desc.MipLevels = 1;
+	desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+	desc.SampleCount = 1;
+	desc.StaticImage = ovrFalse;
+	if (!OVR_SUCCESS(ovr_CreateTextureSwapChainGL(session, &desc, &chain))) {
+		std::cout << "HUD: could not create its swap chain, HUD disabled" << std::endl;
+		chain = nullptr;
+		return;
+	}
+
+	layer.Header.Type = ovrLayerType_Quad;
+	layer.Header.Flags = ovrLayerFlag_TextureOriginAtBottomLeft | ovrLayerFlag_HeadLocked;
+	layer.ColorTexture = chain;
+	layer.Viewport.Pos.x = 0;
+	layer.Viewport.Pos.y = 0;
+	layer.Viewport.Size.w = WIDTH;
+	layer.Viewport.Size.h = HEIGHT;
+	// Half a metre wide, a metre ahead and below eye level, out of the way of the game
+	layer.QuadPoseCenter.Orientation.w = 1.0f;
+	layer.QuadPoseCenter.Position.y = -0.3f;
+	layer.QuadPoseCenter.Position.z = -1.0f;
+	layer.QuadSize.x = 0.5f;
+	layer.QuadSize.y = 0.5f * HEIGHT / WIDTH;
+	pixels.resize(WIDTH * HEIGHT * 4);
+}
+
+void HudLayer::destroy()
+{
+	if (!chain) return;
+	ovr_DestroyTextureSwapChain(session, chain);
+	chain = nullptr;
+	layer.ColorTexture = nullptr;
+	committed = false;
+}
+
+void HudLayer::drawGlyph(char c, int x, int y)
+{
+	if (c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+	for (size_t i = 0; i < sizeof(FONT) / sizeof(FONT[0]); i++) {
+		if (FONT[i].c != c) continue;
+		for (int row = 0; row < GLYPH_HEIGHT * SCALE; row++) {
+			// The texture origin is at the bottom left, so text rows count down from the top of the image
+			unsigned char* line = &pixels[((HEIGHT - 1 - (y + row)) * WIDTH) * 4];
+			for (int col = 0; col < GLYPH_WIDTH * SCALE; col++) {
+				if (!(FONT[i].rows[row / SCALE] & (0x10 >> (col / SCALE)))) continue;
+				memset(&line[(x + col) * 4], 255, 4);
+			}
+		}
+		return;
+	}
+}
+
+void HudLayer::setText(const std::string& text)
+{
+	if (!chain || (committed && text == this->text)) return;
+	this->text = text;
+
+	for (size_t i = 0; i < pixels.size(); i += 4) {
+		pixels[i] = pixels[i + 1] = pixels[i + 2] = 0;
+		pixels[i + 3] = BACKGROUND_ALPHA;
+	}
+	int x = MARGIN, y = MARGIN;
+	for (size_t i = 0; i < text.size(); i++) {
+		if (text[i] == '\n') {
+			x = MARGIN;
+			y += (GLYPH_HEIGHT + 2) * SCALE;
+			continue;
+		}
+		// Clipped rather than wrapped; the HUD is a handful of short lines
+		if (x + GLYPH_WIDTH * SCALE <= WIDTH - MARGIN && y + GLYPH_HEIGHT * SCALE <= HEIGHT - MARGIN)
+			drawGlyph(text[i], x, y);
+		x += (GLYPH_WIDTH + 1) * SCALE;
+	}
+
+	int index;
+	GLuint texture;
+	ovr_GetTextureSwapChainCurrentIndex(session, chain, &index);
+	ovr_GetTextureSwapChainBufferGL(session, chain, index, &texture);
+	GLState::bindTextureForUpdate(0, GL_TEXTURE_2D, texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+	ovr_CommitTextureSwapChain(session, chain);
+	committed = true;
+}
+
+ovrLayerHeader* HudLayer::header()
+{
+	return enabled && committed ? &layer.Header : nullptr;
+}
@@ -0,0 +1,43 @@
+#ifndef _HUD_LAYER_H_
+#define _HUD_LAYER_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <OVR_CAPI.h>
+
+// Status text on its own compositor quad layer, head-locked below the centre of view. The text is
+// drawn on the CPU with a built-in 5x7 font into a small swap chain, and only when it changes; in
+// between, the compositor keeps showing the last committed image, so the eye buffers never pay for it.
+class HudLayer
+{
+public:
+	static const int WIDTH = 512;
+	static const int HEIGHT = 128;
+	// Font pixels are drawn as SCALE x SCALE blocks
+	static const int SCALE = 3;
+
+	HudLayer();
+
+	bool enabled;
+
+	void init(ovrSession session);
+	// Destroys the swap chain; call before the session is destroyed
+	void destroy();
+	// Lines separated by '\n'; lower case is shown as upper case. Redraws and commits only on a change.
+	void setText(const std::string& text);
+	// The layer to submit this frame, or null when there is nothing to show
+	ovrLayerHeader* header();
+
+private:
+	ovrSession session;
+	ovrTextureSwapChain chain;
+	ovrLayerQuad layer;
+	std::string text;
+	bool committed;
+	std::vector<unsigned char> pixels;
+
+	void drawGlyph(char c, int x, int y);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include "HybridMono.h"
+#include "ShaderCache.h"
+#include "GLState.h"
+
+const float HybridMono::FOV_MARGIN = 0.05f;
+const float HybridMono::DEFAULT_SPLIT = 8.0f;
+
+HybridMono::HybridMono()
+{
+	enabled = false;
+	splitDistance = DEFAULT_SPLIT;
+	fbo = 0;
+	colorTexture = 0;
+	depthTexture = 0;
+	vao = 0;
+}
+
+HybridMono::~HybridMono()
+{
+	if (!fbo) return;
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &colorTexture);
+	glDeleteTextures(1, &depthTexture);
+	glDeleteVertexArrays(1, &vao);
+	GLState::invalidate();
+}
+
+void HybridMono::init(const ovrFovPort fov[2], const ovrSizei eyeSize[2])
+{
+	monoFov.LeftTan = std::max(fov[0].LeftTan, fov[1].LeftTan) + FOV_MARGIN;
+	monoFov.RightTan = std::max(fov[0].RightTan, fov[1].RightTan) + FOV_MARGIN;
+	monoFov.UpTan = std::max(fov[0].UpTan, fov[1].UpTan) + FOV_MARGIN;
+	monoFov.DownTan = std::max(fov[0].DownTan, fov[1].DownTan) + FOV_MARGIN;
+	// Pixels per tangent unit of the denser eye, over the wider span
+	float density = std::max(eyeSize[0].w / (fov[0].LeftTan + fov[0].RightTan), eyeSize[1].w / (fov[1].LeftTan + fov[1].RightTan));
+	monoSize.x = (unsigned int)(density * (monoFov.LeftTan + monoFov.RightTan) + 0.5f);
+	density = std::max(eyeSize[0].h / (fov[0].UpTan + fov[0].DownTan), eyeSize[1].h / (fov[1].UpTan + fov[1].DownTan));
+	monoSize.y = (unsigned int)(density * (monoFov.UpTan + monoFov.DownTan) + 0.5f);
+
+	glGenTextures(1, &colorTexture);
+	GLState::bindTextureForUpdate(0, GL_TEXTURE_2D, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, monoSize.x, monoSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Depth is only read to tell covered texels from empty ones, so no filtering
+	glGenTextures(1, &depthTexture);
+	GLState::bindTextureForUpdate(0, GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, monoSize.x, monoSize.y, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	glGenVertexArrays(1, &vao);
+}
+
+glm::mat4 HybridMono::projection(float farPlane) const
+{
+	float n = splitDistance;
+	return glm::frustum(-monoFov.LeftTan * n, monoFov.RightTan * n, -monoFov.DownTan * n, monoFov.UpTan * n, n, farPlane);
+}
+
+glm::mat4 HybridMono::centerPose(const glm::mat4& leftPose, const glm::mat4& rightPose)
+{
+	// The eyes share the head's orientation, so only the position needs averaging
+	glm::mat4 pose = leftPose;
+	pose[3] = (leftPose[3] + rightPose[3]) * 0.5f;
+	return pose;
+}
+
+void HybridMono::composite(const glm::mat4& eyePose, const glm::mat4& monoPose, float farPlane, const glm::vec4& eyeTangents)
+{
+	// Half the IPD at the split distance is a few pixels of parallax, so the shader reprojects with depth
+	glm::mat4 eyeToMono = glm::inverse(monoPose) * eyePose;
+	GLint program = ShaderCache::get("hybrid.vert", "hybrid.frag");
+	if (!program) return;
+	GLState::useProgram(program);
+	GLState::bindTexture(0, GL_TEXTURE_2D, colorTexture);
+	GLState::bindTexture(1, GL_TEXTURE_2D, depthTexture);
+	GLState::bindVertexArray(vao);
+	GLState::setEnabled(GL_CULL_FACE, false);
+	GLState::uniform1i("monoColor", 0);
+	GLState::uniform1i("monoDepth", 1);
+	GLState::uniformMatrix4fv("eyeToMono", &eyeToMono[0][0]);
+	GLState::uniform4f("eyeTangents", eyeTangents.x, eyeTangents.y, eyeTangents.z, eyeTangents.w);
+	GLState::uniform4f("monoTangents", -monoFov.LeftTan, -monoFov.DownTan, monoFov.RightTan, monoFov.UpTan);
+	GLState::uniform2f("monoClip", splitDistance, farPlane);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
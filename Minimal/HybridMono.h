@@ -0,0 +1,49 @@
+#ifndef _HYBRID_MONO_H_
+#define _HYBRID_MONO_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <OVR_CAPI.h>
+
+// Hybrid mono rendering. Past splitDistance the two eyes see practically the same image, so that part
+// of the scene is rendered once, from a camera between the eyes with a FOV covering both of them, into
+// its own colour and depth target. Each eye then renders only the near part (its far plane moved in
+// to splitDistance) and composite() fills the pixels the near pass left empty with the mono image,
+// reprojected to the eye.
+class HybridMono
+{
+public:
+	// Extra FOV on every side of the mono camera, in tangent units, for the eyes' offset and rotation
+	static const float FOV_MARGIN;
+	static const float DEFAULT_SPLIT;
+
+	HybridMono();
+	~HybridMono();
+
+	bool enabled;
+	// Metres from the eye where near (stereo) content ends and far (mono) content begins
+	float splitDistance;
+
+	// Sizes the mono target so its pixel density matches the eye buffers
+	void init(const ovrFovPort fov[2], const ovrSizei eyeSize[2]);
+	GLuint framebuffer() const { return fbo; }
+	glm::uvec2 size() const { return monoSize; }
+	const ovrFovPort& fov() const { return monoFov; }
+	// The mono camera's projection, from splitDistance out to farPlane
+	glm::mat4 projection(float farPlane) const;
+	// Pose halfway between the two eye poses (world from eye)
+	static glm::mat4 centerPose(const glm::mat4& leftPose, const glm::mat4& rightPose);
+
+	// Over the current viewport, whose view is given by eyePose and its tangent bounds (left, bottom,
+	// right, top, left and bottom negative), draws the mono image behind whatever is already in depth.
+	// The image is reprojected through the mono depth to the eye's position; farPlane is the one the
+	// mono pass was drawn with.
+	void composite(const glm::mat4& eyePose, const glm::mat4& monoPose, float farPlane, const glm::vec4& eyeTangents);
+
+private:
+	GLuint fbo, colorTexture, depthTexture, vao;
+	glm::uvec2 monoSize;
+	ovrFovPort monoFov;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <Windows.h>
+#include "InputSampler.h"
+
+const float InputSampler::PRESS = 0.55f;
+const float InputSampler::RELEASE = 0.45f;
+
+InputSampler::InputSampler() : session(nullptr), running(false), overflow(0)
+{
+}
+
+InputSampler::~InputSampler()
+{
+	stop();
+}
+
+void InputSampler::start(ovrSession session)
+{
+	if (running) return;
+	this->session = session;
+	running = true;
+	thread = std::thread(&InputSampler::sample, this);
+}
+
+void InputSampler::stop()
+{
+	if (!running) return;
+	running = false;
+	thread.join();
+}
+
+void InputSampler::publish(const InputEvent& event)
+{
+	if (!events.push(event)) overflow++;
+}
+
+void InputSampler::sample()
+{
+	// The default 15.6 ms timer would make the sleeps below far longer than the sample period
+	timeBeginPeriod(1);
+	bool triggers[ovrHand_Count] = { false, false };
+	unsigned int buttons = 0;
+	// The first sample only records the state, so a button already held at start() is not a press
+	bool seeded = false;
+	auto period = std::chrono::microseconds(1000000 / SAMPLE_RATE);
+	auto next = std::chrono::steady_clock::now();
+	while (running) {
+		ovrInputState state;
+		bool ok = OVR_SUCCESS(ovr_GetInputState(session, ovrControllerType_Touch, &state));
+		if (ok && !seeded) {
+			for (int hand = 0; hand < ovrHand_Count; hand++)
+				triggers[hand] = state.IndexTrigger[hand] > PRESS;
+			buttons = state.Buttons;
+			seeded = true;
+		}
+		else if (ok) {
+			InputEvent event;
+			event.time = state.TimeInSeconds;
+			event.button = 0;
+			for (int hand = 0; hand < ovrHand_Count; hand++) {
+				float value = state.IndexTrigger[hand];
+				bool pressed = triggers[hand] ? value > RELEASE : value > PRESS;
+				if (pressed == triggers[hand]) continue;
+				triggers[hand] = pressed;
+				event.type = pressed ? InputEvent::TRIGGER_PRESS : InputEvent::TRIGGER_RELEASE;
+				event.hand = (ovrHandType)hand;
+				publish(event);
+			}
+
+			unsigned int changed = state.Buttons ^ buttons;
+			event.hand = ovrHand_Left;
+			for (unsigned int bit = 1; changed; bit <<= 1) {
+				if (!(changed & bit)) continue;
+				changed &= ~bit;
+				event.type = (state.Buttons & bit) ? InputEvent::BUTTON_PRESS : InputEvent::BUTTON_RELEASE;
+				event.button = bit;
+				publish(event);
+			}
+			buttons = state.Buttons;
+		}
+
+		next += period;
+		auto now = std::chrono::steady_clock::now();
+		if (next < now) next = now;
+		else std::this_thread::sleep_until(next);
+	}
+	timeEndPeriod(1);
+}
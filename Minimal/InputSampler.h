@@ -0,0 +1,54 @@
+#ifndef _INPUT_SAMPLER_H_
+#define _INPUT_SAMPLER_H_
+
+#include <atomic>
+#include <thread>
+#include <OVR_CAPI.h>
+#include "SpscQueue.h"
+
+struct InputEvent {
+	enum Type { TRIGGER_PRESS, TRIGGER_RELEASE, BUTTON_PRESS, BUTTON_RELEASE };
+	Type type;
+	// ovr_GetTimeInSeconds of the sample the edge was seen in
+	double time;
+	// Index trigger events
+	ovrHandType hand;
+	// Button events: a single ovrButton bit
+	unsigned int button;
+};
+
+// Polls the Touch controllers on its own thread at SAMPLE_RATE, well above the frame rate, and turns
+// trigger and button changes into timestamped press and release events. A press and release that both
+// fall between two frames still reach the game as two events, and input latency no longer depends on
+// how long a frame takes. The render thread drains the events with poll().
+class InputSampler
+{
+public:
+	static const int SAMPLE_RATE = 500;
+	// Trigger hysteresis: pressed above PRESS, released again below RELEASE
+	static const float PRESS;
+	static const float RELEASE;
+	static const size_t QUEUE_SIZE = 256;
+
+	InputSampler();
+	~InputSampler();
+
+	void start(ovrSession session);
+	void stop();
+	// Next event in the order they happened; false when there are no more
+	bool poll(InputEvent& event) { return events.pop(event); }
+	// Events lost because the render thread fell QUEUE_SIZE events behind
+	unsigned int overflows() const { return overflow.load(); }
+
+private:
+	ovrSession session;
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<unsigned int> overflow;
+	SpscQueue<InputEvent, QUEUE_SIZE> events;
+
+	void sample();
+	void publish(const InputEvent& event);
+};
+
+#endif
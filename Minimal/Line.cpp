@@ -1,4 +1,5 @@
 #include "Line.h"
+#include "GLState.h"
 
 Line::Line()
 {
@@ -10,11 +11,11 @@ Line::Line()
 	
 	// Bind the Vertex Array Object (VAO) first, then bind the associated buffers to it.
 	// Consider the VAO as a container for all your buffers.
-	glBindVertexArray(VAO);
+	GLState::bindVertexArray(VAO);
 
 	// Now bind a VBO to it as a GL_ARRAY_BUFFER. The GL_ARRAY_BUFFER is an array containing relevant data to what
 	// you want to draw, such as vertices, normals, colors, etc.
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
 	// glBufferData populates the most recently bound buffer with data starting at the 3rd argument and ending after
 	// the 2nd argument number of indices. How does OpenGL know how long an index spans? Go to glVertexAttribPointer.
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -26,12 +27,6 @@ Line::Line()
 		GL_FALSE, // GL_TRUE means the values should be normalized. GL_FALSE means they shouldn't
 		3 * sizeof(GLfloat), // Offset between consecutive indices. Since each of our vertices have 3 floats, they should have the size of 3 floats in between
 		(GLvoid*)0); // Offset of the first vertex's component. In our case it's 0 since we don't pad the vertices array with anything.
-
-	// Unbind the currently bound buffer so that we don't accidentally make unwanted changes to it.
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	// Unbind the VAO now so we don't accidentally tamper with it.
-	// NOTE: You must NEVER unbind the element array buffer associated with a VAO!
-	glBindVertexArray(0);
 }
 
 Line::~Line()
@@ -40,6 +35,7 @@ Line::~Line()
 	// large project! This could crash the graphics driver due to memory leaks, or slow down application performance!
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
+	GLState::invalidate();
 }
 
 void Line::draw(GLuint shaderProgram)
@@ -48,28 +44,24 @@ void Line::draw(GLuint shaderProgram)
 
 void Line::draw(glm::mat4 C, GLint shaderProgram, glm::mat4 P, glm::mat4 V) {
 	// We need to calcullate this because modern OpenGL does not keep track of any matrix other than the viewport (D)
-	// Consequently, we need to forward the projection, view, and model matrices to the shader programs
-	// Get the location of the uniform variables "projection" and "modelview"
-	glLineWidth(10.0f);
-	GLuint uAmbient = glGetUniformLocation(shaderProgram, "material.ambient");
-	GLuint uDiffuse = glGetUniformLocation(shaderProgram, "material.diffuse");
-	if( !pressed ) glUniform3f(uAmbient, 0.0f, 1.0f, 0.0f);
-	else glUniform3f(uAmbient, 1.0f, 0.0f, 0.0f);
-	if (!pressed) glUniform3f(uDiffuse, 0.0f, 1.0f, 0.0f);
-	else glUniform3f(uDiffuse, 1.0f, 0.0f, 0.0f);
-	uProjection = glGetUniformLocation(shaderProgram, "projection");
-	uModel = glGetUniformLocation(shaderProgram, "model");
-	uView = glGetUniformLocation(shaderProgram, "view");
-	// Now send these values to the shader program
-	glUniformMatrix4fv(uProjection, 1, GL_FALSE, &P[0][0]);
-	glUniformMatrix4fv(uModel, 1, GL_FALSE, &V[0][0]);
-	glUniformMatrix4fv(uView, 1, GL_FALSE, &C[0][0]);
-	// Now draw the cube. We simply need to bind the VAO associated with it.
-	glBindVertexArray(VAO);
-	// Tell OpenGL to draw with triangles, using 36 indices, the type of the indices, and the offset to start from
+	// Consequently, we need to forward the projection, view, and model matrices to the shader programs.
+	// GLState skips whatever the previous line already set, usually everything but the transform.
+	GLState::useProgram(shaderProgram);
+	GLState::lineWidth(10.0f);
+	if (!pressed) {
+		GLState::uniform3f("material.ambient", 0.0f, 1.0f, 0.0f);
+		GLState::uniform3f("material.diffuse", 0.0f, 1.0f, 0.0f);
+	}
+	else {
+		GLState::uniform3f("material.ambient", 1.0f, 0.0f, 0.0f);
+		GLState::uniform3f("material.diffuse", 1.0f, 0.0f, 0.0f);
+	}
+	GLState::uniformMatrix4fv("projection", &P[0][0]);
+	GLState::uniformMatrix4fv("model", &V[0][0]);
+	GLState::uniformMatrix4fv("view", &C[0][0]);
+	// Now draw the line. We simply need to bind the VAO associated with it.
+	GLState::bindVertexArray(VAO);
 	glDrawArrays(GL_LINES, 0, 2);
-	// Unbind the VAO when we're done so we don't accidentally draw extra stuff or tamper with its bound buffers
-	glBindVertexArray(0);
 }
 
 void Line::update()
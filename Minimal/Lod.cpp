@@ -0,0 +1,31 @@
+#include "Lod.h"
+
+const float Lod::SCREEN_SIZE[Lod::MAX_LODS] = { 0.20f, 0.10f, 0.05f, 0.0f };
+const float Lod::HYSTERESIS = 0.15f;
+
+int Lod::currentView = 0;
+int* Lod::instanceState = 0;
+unsigned int Lod::trianglesDrawn[Lod::MAX_LODS];
+bool Lod::counting = true;
+
+int Lod::select(float screenSize, int lodCount)
+{
+	int previous = instanceState ? instanceState[currentView] : -1;
+	int lod = 0;
+	while (lod < lodCount - 1) {
+		float threshold = SCREEN_SIZE[lod];
+		// Going coarser has to clear the threshold by the hysteresis margin, and so does going back to finer
+		if (previous > lod) threshold *= 1.0f + HYSTERESIS;
+		else if (previous >= 0) threshold *= 1.0f - HYSTERESIS;
+		if (screenSize >= threshold) break;
+		lod++;
+	}
+	if (instanceState) instanceState[currentView] = lod;
+	return lod;
+}
+
+void Lod::resetStats()
+{
+	for (int i = 0; i < MAX_LODS; i++)
+		trianglesDrawn[i] = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef _LOD_H_
+#define _LOD_H_
+
+// Distance-based level-of-detail selection shared by every Model.
+// LOD 0 is full detail; each following level has roughly half the triangles of the previous one.
+class Lod
+{
+public:
+	static const int MAX_LODS = 4;
+	// Both eyes, then the hybrid mono camera (ovrEye_Count)
+	static const int MAX_VIEWS = 3;
+
+	// Projected bounding-sphere radius, in NDC units of the viewport height, below which each LOD gives way to the next
+	static const float SCREEN_SIZE[MAX_LODS];
+	// Fraction a projected size must move past a threshold before the selection changes
+	static const float HYSTERESIS;
+
+	// View being rendered (eye index, or MAX_VIEWS - 1 for the mono camera); set by the renderer before each pass
+	static int currentView;
+	// Per-view LOD last chosen for the instance being drawn; set by MatrixTransform::draw, null when drawn outside one
+	static int* instanceState;
+	// Triangles submitted at each LOD since the last resetStats()
+	static unsigned int trianglesDrawn[MAX_LODS];
+	// Cleared by the renderer around passes that redraw geometry already counted, like the depth pre-pass
+	static bool counting;
+
+	static int select(float screenSize, int lodCount);
+	static void resetStats();
+};
+
+#endif
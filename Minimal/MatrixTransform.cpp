@@ -16,6 +16,13 @@ MatrixTransform::MatrixTransform(glm::mat4 M)
     this->move = glm::vec3(0.0f, 0.0f, 0.0f);
 	glm::vec4 tmp_pos = M * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 	this->pos = glm::vec3(tmp_pos.x, tmp_pos.y, tmp_pos.z);
+	for (int i = 0; i < Lod::MAX_VIEWS; i++)
+		this->lod[i] = 0;
+}
+
+// Children are not owned: the molecule Models are shared by every transform and held by the scene
+MatrixTransform::~MatrixTransform()
+{
 }
 
 void MatrixTransform::draw(glm::mat4 C)
@@ -30,7 +37,11 @@ void MatrixTransform::draw(glm::mat4 C, GLint shaderProgram, glm::mat4 P, glm::m
 
 	glm::mat4 M_new = C * M;
 
+	// Models below this transform keep their level-of-detail hysteresis state here
+	int* parentLod = Lod::instanceState;
+	Lod::instanceState = this->lod;
 	Group::draw(M_new, shaderProgram, P, V);
+	Lod::instanceState = parentLod;
 }
 
 void MatrixTransform::rotate(float angle, glm::vec3 axis)
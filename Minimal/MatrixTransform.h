@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include "Group.h"
+#include "Lod.h"
 
 class MatrixTransform : public Group {
 public:
@@ -27,6 +28,7 @@ public:
     glm::vec3 axis;
     glm::vec3 move;
 	glm::vec3 pos;
+	int lod[Lod::MAX_VIEWS]; // level of detail last used for this instance in each view
 };
 
 #endif /* MatrixTransform_hpp */
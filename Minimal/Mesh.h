@@ -13,6 +13,10 @@ using namespace std;
 #include <assimp/types.h>
 #include "Geode.h"
 #include "Window.h"
+#include "Lod.h"
+#include "ShaderCache.h"
+#include "GLState.h"
+#include "TextureCache.h"
 
 
 struct Vertex {
@@ -24,8 +28,9 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// One image a mesh uses
 struct Texture {
-    GLuint id;
+    GLint handle;   // TextureCache handle
     string type;
     aiString path;
 };
@@ -35,6 +40,8 @@ struct Material {
     aiColor3D diffuse;
     aiColor3D specular;
     float shininess;
+    // TextureCache handle of the diffuse map, -1 without one
+    GLint diffuseTexture;
 };
 
 class Mesh : public Geode {
@@ -44,20 +51,35 @@ public:
     vector<GLuint> indices;
     vector<Texture> textures;
     Material material;
+    // Index ranges of each level of detail inside indices, LOD 0 first
+    vector<GLuint> lodOffsets;
+    vector<GLuint> lodCounts;
+    // Closed meshes are drawn with back-face culling
+    bool closed;
 
     glm::mat4 toWorld;
     GLuint uProjection, uModel, uView, uAmbient, uDiffuse, uSpecular, uShininess;
 
     /*  Functions  */
-    // Constructor
-    Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, Material material)
+    // Constructor. indices may hold several levels of detail back to back, lodCounts giving the index count of each.
+    Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, Material material, vector<GLuint> lodCounts = vector<GLuint>())
     {
         toWorld = glm::mat4(1.0f);
+        closed = false;
+        instanceVBO = 0;
 
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
         this->material = material;
+        if (lodCounts.empty())
+            lodCounts.push_back(indices.size());
+        GLuint offset = 0;
+        for (GLuint i = 0; i < lodCounts.size(); i++) {
+            this->lodOffsets.push_back(offset);
+            this->lodCounts.push_back(lodCounts[i]);
+            offset += lodCounts[i];
+        }
 
         // Now that we have all the required data, set the vertex buffers and its attribute pointers.
         this->setupMesh();
@@ -80,41 +102,12 @@ public:
         glUniform3f(uDiffuse, material.diffuse.r, material.diffuse.g, material.diffuse.b);
         glUniform3f(uSpecular, material.specular.r, material.specular.g, material.specular.b);
         glUniform1f(uShininess, material.shininess);
-        // Bind appropriate textures
-        GLuint diffuseNr = 1;
-        GLuint specularNr = 1;
-        for(GLuint i = 0; i < this->textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // Active proper texture unit before binding
-            // Retrieve texture number (the N in diffuse_textureN)
-            stringstream ss;
-            string number;
-            string name = this->textures[i].type;
-            if(name == "texture_diffuse")
-                ss << diffuseNr++; // Transfer GLuint to stream
-            else if(name == "texture_specular")
-                ss << specularNr++; // Transfer GLuint to stream
-            number = ss.str();
-            // Now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shaderProgram, (name + number).c_str()), i);
-            // And finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
-        }
-
-        // Also set each mesh's shininess property to a default value (if you want you could extend this to another mesh property and possibly change this value)
-        // glUniform1f(glGetUniformLocation(shaderProgram, "material.shininess"), 16.0f);
+        // The desktop shaders are untextured; diffuse maps are only sampled by shader2.frag's TEXTURED variant
 
         // Draw mesh
         glBindVertexArray(this->VAO);
-        glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, this->lodCounts[0], GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
-
-        // Always good practice to set everything back to defaults once configured.
-        for (GLuint i = 0; i < this->textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
     }
 
     void draw(glm::mat4 C)
@@ -134,98 +127,59 @@ public:
         glUniform3f(uDiffuse, material.diffuse.r, material.diffuse.g, material.diffuse.b);
         glUniform3f(uSpecular, material.specular.r, material.specular.g, material.specular.b);
         glUniform1f(uShininess, material.shininess);
-        // Bind appropriate textures
-        GLuint diffuseNr = 1;
-        GLuint specularNr = 1;
-        for(GLuint i = 0; i < this->textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // Active proper texture unit before binding
-            // Retrieve texture number (the N in diffuse_textureN)
-            stringstream ss;
-            string number;
-            string name = this->textures[i].type;
-            if(name == "texture_diffuse")
-                ss << diffuseNr++; // Transfer GLuint to stream
-            else if(name == "texture_specular")
-                ss << specularNr++; // Transfer GLuint to stream
-            number = ss.str();
-            // Now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shaderProgram, (name + number).c_str()), i);
-            // And finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
-        }
-
-        // Also set each mesh's shininess property to a default value (if you want you could extend this to another mesh property and possibly change this value)
-        // glUniform1f(glGetUniformLocation(shaderProgram, "material.shininess"), 16.0f);
+        // The desktop shaders are untextured; diffuse maps are only sampled by shader2.frag's TEXTURED variant
 
         // Draw mesh
         glBindVertexArray(this->VAO);
-        glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, this->lodCounts[0], GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
-
-        // Always good practice to set everything back to defaults once configured.
-        for (GLuint i = 0; i < this->textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
     }
 
 	void draw(glm::mat4 C, GLint shaderProgram, glm::mat4 P, glm::mat4 V)
 	{
-		uProjection = glGetUniformLocation(shaderProgram, "projection");
-		uModel = glGetUniformLocation(shaderProgram, "model");
-		uView = glGetUniformLocation(shaderProgram, "view");
-		uAmbient = glGetUniformLocation(shaderProgram, "material.ambient");
-		uDiffuse = glGetUniformLocation(shaderProgram, "material.diffuse");
-		uSpecular = glGetUniformLocation(shaderProgram, "material.specular");
-		uShininess = glGetUniformLocation(shaderProgram, "material.shininess");
-		glUniformMatrix4fv(uProjection, 1, GL_FALSE, &P[0][0]);
-		glUniformMatrix4fv(uModel, 1, GL_FALSE, &V[0][0]);
-		glUniformMatrix4fv(uView, 1, GL_FALSE, &C[0][0]);
-		glUniform3f(uAmbient, material.ambient.r, material.ambient.g, material.ambient.b);
-		glUniform3f(uDiffuse, material.diffuse.r, material.diffuse.g, material.diffuse.b);
-		glUniform3f(uSpecular, material.specular.r, material.specular.g, material.specular.b);
-		glUniform1f(uShininess, material.shininess);
-		// Bind appropriate textures
-		/*
-		GLuint diffuseNr = 1;
-		GLuint specularNr = 1;
-		for (GLuint i = 0; i < this->textures.size(); i++)
-		{
-			glActiveTexture(GL_TEXTURE0 + i); // Active proper texture unit before binding
-											  // Retrieve texture number (the N in diffuse_textureN)
-			stringstream ss;
-			string number;
-			string name = this->textures[i].type;
-			if (name == "texture_diffuse")
-				ss << diffuseNr++; // Transfer GLuint to stream
-			else if (name == "texture_specular")
-				ss << specularNr++; // Transfer GLuint to stream
-			number = ss.str();
-			// Now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shaderProgram, (name + number).c_str()), i);
-			// And finally bind the texture
-			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
-		}
-		*/
+		draw(C, shaderProgram, P, V, 0);
+	}
 
-		// Also set each mesh's shininess property to a default value (if you want you could extend this to another mesh property and possibly change this value)
-		// glUniform1f(glGetUniformLocation(shaderProgram, "material.shininess"), 16.0f);
+	void draw(glm::mat4 C, GLint shaderProgram, glm::mat4 P, glm::mat4 V, int lod)
+	{
+		GLState::useProgram(shaderProgram);
+		GLState::uniformMatrix4fv("projection", &P[0][0]);
+		GLState::uniformMatrix4fv("model", &V[0][0]);
+		GLState::uniformMatrix4fv("view", &C[0][0]);
+		this->setMaterial();
 
 		// Draw mesh
-		glBindVertexArray(this->VAO);
-		glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+		GLState::setEnabled(GL_CULL_FACE, this->closed);
+		GLState::bindVertexArray(this->VAO);
+		glDrawElements(GL_TRIANGLES, this->lodCounts[lod], GL_UNSIGNED_INT, (GLvoid*)(this->lodOffsets[lod] * sizeof(GLuint)));
+		if (Lod::counting) Lod::trianglesDrawn[lod] += this->lodCounts[lod] / 3;
+	}
 
-		// Always good practice to set everything back to defaults once configured.
-		/*
-		for (GLuint i = 0; i < this->textures.size(); i++)
-		{
-			glActiveTexture(GL_TEXTURE0 + i);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-		*/
+	// Draws one copy of the mesh per world matrix in a single call. The program must be an INSTANCED variant.
+	void drawInstanced(const vector<glm::mat4>& instances, GLint shaderProgram, glm::mat4 P, glm::mat4 V, int lod = 0)
+	{
+		if (instances.empty()) return;
+		GLState::useProgram(shaderProgram);
+		GLState::uniformMatrix4fv("projection", &P[0][0]);
+		GLState::uniformMatrix4fv("model", &V[0][0]);
+		this->setMaterial();
+
+		if (!this->instanceVBO) this->setupInstancing();
+		// Orphan the previous contents so the driver does not wait for draws still reading them
+		GLState::bindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(glm::mat4), &instances[0]);
+
+		GLState::setEnabled(GL_CULL_FACE, this->closed);
+		GLState::bindVertexArray(this->VAO);
+		glDrawElementsInstanced(GL_TRIANGLES, this->lodCounts[lod], GL_UNSIGNED_INT, (GLvoid*)(this->lodOffsets[lod] * sizeof(GLuint)), (GLsizei)instances.size());
+		if (Lod::counting) Lod::trianglesDrawn[lod] += this->lodCounts[lod] / 3 * (unsigned)instances.size();
+	}
+
+	// ShaderCache features this mesh's material needs
+	unsigned int shaderFeatures() const
+	{
+		return this->material.diffuseTexture >= 0 ? ShaderCache::TEXTURED : 0;
 	}
 
     void update() {
@@ -235,6 +189,8 @@ public:
 private:
     /*  Render data  */
     GLuint VAO, VBO, EBO;
+    // Per-instance world matrices for drawInstanced, created on first use
+    GLuint instanceVBO;
 
     /*  Functions    */
     // Initializes all the buffer objects/arrays
@@ -245,9 +201,9 @@ private:
         glGenBuffers(1, &this->VBO);
         glGenBuffers(1, &this->EBO);
 
-        glBindVertexArray(this->VAO);
+        GLState::bindVertexArray(this->VAO);
         // Load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, this->VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
@@ -266,7 +222,36 @@ private:
         // Vertex Texture Coords
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
-
-        glBindVertexArray(0);
     }
+
+	// Attribute locations 3-6 take one column each of the per-instance world matrix
+	void setupInstancing()
+	{
+		glGenBuffers(1, &this->instanceVBO);
+		GLState::bindVertexArray(this->VAO);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+		for (GLuint column = 0; column < 4; column++) {
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + column, 1);
+		}
+	}
+
+	// Material uniforms of the current program; unchanged values are skipped by GLState
+	void setMaterial()
+	{
+		GLState::uniform3f("material.ambient", material.ambient.r, material.ambient.g, material.ambient.b);
+		GLState::uniform3f("material.diffuse", material.diffuse.r, material.diffuse.g, material.diffuse.b);
+		GLState::uniform3f("material.specular", material.specular.r, material.specular.g, material.specular.b);
+		GLState::uniform1f("material.shininess", material.shininess);
+		// Meshes sharing a texture array differ only in the layer, so the bind is usually skipped.
+		// The layer is written even when untextured, for TEXTURED programs drawing mixed models.
+		GLint diffuseLayer = -1;
+		if (material.diffuseTexture >= 0) {
+			TextureLayer diffuse = TextureCache::layer(material.diffuseTexture);
+			GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, diffuse.array);
+			diffuseLayer = diffuse.layer;
+		}
+		GLState::uniform1i("diffuseLayer", diffuseLayer);
+	}
 };
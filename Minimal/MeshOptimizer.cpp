@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include "MeshOptimizer.h"
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = { 0.0f, 0.0f };
+	if (indices.empty() || vertexCount == 0) return stats;
+
+	// A vertex is still in the FIFO if fewer than cacheSize misses happened since it was last loaded
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int unique = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		GLuint v = indices[i];
+		if (time - timestamps[v] > cacheSize) {
+			timestamps[v] = time++;
+			misses++;
+		}
+		if (!referenced[v]) {
+			referenced[v] = true;
+			unique++;
+		}
+	}
+	stats.acmr = (float)misses / (float)(indices.size() / 3);
+	stats.atvr = (float)misses / (float)unique;
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount, std::vector<size_t>& clusters, unsigned int cacheSize)
+{
+	clusters.clear();
+	size_t faceCount = indices.size() / 3;
+	if (faceCount == 0) return;
+
+	// Vertex -> triangle adjacency, stored as one flat array with per-vertex offsets
+	std::vector<unsigned int> liveCount(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		liveCount[indices[i]]++;
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + liveCount[v];
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t f = 0; f < faceCount; f++)
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[f * 3 + k]]++] = (unsigned int)f;
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(faceCount, false);
+	std::vector<GLuint> deadEnd;
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> result;
+	deadEnd.reserve(indices.size());
+	result.reserve(indices.size());
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0;
+	long long fanning = indices[0];
+
+	clusters.push_back(0);
+	while (fanning >= 0) {
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+			unsigned int f = adjacency[a];
+			if (emitted[f]) continue;
+			for (int k = 0; k < 3; k++) {
+				GLuint v = indices[f * 3 + k];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveCount[v]--;
+				if (time - timestamps[v] > cacheSize)
+					timestamps[v] = time++;
+			}
+			emitted[f] = true;
+		}
+
+		// Prefer the candidate that will still be in cache after its remaining triangles are emitted
+		long long next = -1;
+		int bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); c++) {
+			GLuint v = candidates[c];
+			if (liveCount[v] == 0) continue;
+			int priority = 0;
+			if (time - timestamps[v] + 2 * liveCount[v] <= cacheSize)
+				priority = (int)(time - timestamps[v]);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (next < 0) {
+			// Dead end: back up through recently used vertices, then fall back to a linear scan
+			while (!deadEnd.empty()) {
+				GLuint d = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveCount[d] > 0) {
+					next = d;
+					break;
+				}
+			}
+			while (next < 0 && cursor < vertexCount) {
+				if (liveCount[cursor] > 0) next = (long long)cursor;
+				cursor++;
+			}
+			// Restarting from a vertex that has left the cache is where a cluster may be moved freely
+			if (next >= 0 && time - timestamps[next] > cacheSize)
+				clusters.push_back(result.size());
+		}
+		fanning = next;
+	}
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices, const std::vector<size_t>& clusters)
+{
+	if (clusters.size() < 2) return;
+
+	struct Cluster {
+		size_t begin, end;
+		glm::vec3 centroid;
+		glm::vec3 normal;
+		float sortKey;
+	};
+	std::vector<Cluster> sorted(clusters.size());
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusters.size(); c++) {
+		Cluster& cluster = sorted[c];
+		cluster.begin = clusters[c];
+		cluster.end = (c + 1 < clusters.size()) ? clusters[c + 1] : indices.size();
+		cluster.centroid = glm::vec3(0.0f);
+		cluster.normal = glm::vec3(0.0f);
+		float clusterArea = 0.0f;
+		for (size_t i = cluster.begin; i < cluster.end; i += 3) {
+			const glm::vec3& p0 = vertices[indices[i]].Position;
+			const glm::vec3& p1 = vertices[indices[i + 1]].Position;
+			const glm::vec3& p2 = vertices[indices[i + 2]].Position;
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(n);
+			cluster.centroid += (p0 + p1 + p2) * (area / 3.0f);
+			cluster.normal += n;
+			clusterArea += area;
+		}
+		meshCentroid += cluster.centroid;
+		meshArea += clusterArea;
+		if (clusterArea > 0.0f) cluster.centroid /= clusterArea;
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	// Clusters facing away from the mesh centre are the likely occluders, so they go first
+	for (size_t c = 0; c < sorted.size(); c++) {
+		Cluster& cluster = sorted[c];
+		float len = glm::length(cluster.normal);
+		cluster.sortKey = (len > 0.0f) ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / len) : 0.0f;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for (size_t c = 0; c < sorted.size(); c++)
+		result.insert(result.end(), indices.begin() + sorted[c].begin, indices.begin() + sorted[c].end);
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	const GLuint unused = ~0u;
+	std::vector<GLuint> remap(vertices.size(), unused);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		GLuint& v = indices[i];
+		if (remap[v] == unused) {
+			remap[v] = (GLuint)result.size();
+			result.push_back(vertices[v]);
+		}
+		v = remap[v];
+	}
+	vertices.swap(result);
+}
+
+bool MeshOptimizer::isClosed(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	if (indices.empty()) return false;
+	std::unordered_map<glm::vec3, GLuint, PositionHash, PositionEqual> firstAtPosition;
+	std::vector<GLuint> welded(vertices.size());
+	for (GLuint v = 0; v < vertices.size(); v++)
+		welded[v] = firstAtPosition.insert(std::make_pair(vertices[v].Position, v)).first->second;
+
+	// Count each undirected edge; a closed 2-manifold uses every edge exactly twice
+	std::map<std::pair<GLuint, GLuint>, int> edgeUse;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		for (int k = 0; k < 3; k++) {
+			GLuint a = welded[indices[i + k]];
+			GLuint b = welded[indices[i + (k + 1) % 3]];
+			if (a > b) std::swap(a, b);
+			edgeUse[std::make_pair(a, b)]++;
+		}
+	}
+	for (auto it = edgeUse.begin(); it != edgeUse.end(); ++it)
+		if (it->second != 2) return false;
+	return true;
+}
+
+void MeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	std::vector<size_t> clusters;
+	optimizeVertexCache(indices, vertices.size(), clusters);
+	optimizeOverdraw(indices, vertices, clusters);
+	optimizeVertexFetch(vertices, indices);
+}
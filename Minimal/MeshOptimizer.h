@@ -0,0 +1,54 @@
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include <vector>
+#include <GL/glew.h>
+#include "Mesh.h"
+
+// Cache statistics for an indexed triangle list, measured with a simulated FIFO post-transform cache.
+struct VertexCacheStats {
+	float acmr; // Average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3.0 is worst)
+	float atvr; // Average transformed vertex ratio: transformed vertices per unique vertex (1.0 is ideal)
+};
+
+// Hashes and compares vertex positions bit for bit, for welding vertices at the same position
+struct PositionHash {
+	size_t operator()(const glm::vec3& p) const {
+		const unsigned int* bits = reinterpret_cast<const unsigned int*>(&p.x);
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+struct PositionEqual {
+	bool operator()(const glm::vec3& a, const glm::vec3& b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+};
+
+// Import-time reordering of mesh data, run once per mesh by Model::processMesh.
+// Vertex welding itself is left to assimp (aiProcess_JoinIdenticalVertices).
+class MeshOptimizer
+{
+public:
+	// Size of the simulated post-transform cache. 16 is a conservative value for current GPUs.
+	static const unsigned int CACHE_SIZE = 16;
+
+	static VertexCacheStats analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE);
+
+	// Reorders triangles for post-transform cache hits (Tipsify, Sander et al. 2007).
+	// clusters receives the first index of every run that starts at a cache dead-end.
+	static void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount, std::vector<size_t>& clusters, unsigned int cacheSize = CACHE_SIZE);
+
+	// Reorders the clusters produced by optimizeVertexCache so outward-facing ones are drawn first.
+	static void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices, const std::vector<size_t>& clusters);
+
+	// Renumbers vertices in the order the index buffer first touches them and drops unreferenced ones.
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	// Runs the three passes above in order.
+	static void optimize(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	// True when every edge is shared by exactly two triangles, i.e. back faces can never be seen.
+	// Vertices at the same position count as one, so attribute seams do not open the mesh.
+	static bool isClosed(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <unordered_map>
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+namespace {
+	// Symmetric 4x4 error quadric, stored as its upper triangle, plus the total weight of its planes
+	struct Quadric {
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, w;
+
+		Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), w(0) {}
+
+		Quadric(double a, double b, double c, double d, double w)
+			: a2(w*a*a), ab(w*a*b), ac(w*a*c), ad(w*a*d), b2(w*b*b), bc(w*b*c), bd(w*b*d), c2(w*c*c), cd(w*c*d), d2(w*d*d), w(w) {}
+
+		void add(const Quadric& q) {
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+			bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2; w += q.w;
+		}
+
+		double error(const glm::vec3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			return a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x + b2*y*y + 2*bc*y*z + 2*bd*y + c2*z*z + 2*cd*z + d2;
+		}
+	};
+
+	struct Collapse {
+		GLuint from, to;
+		double cost;
+		bool operator<(const Collapse& other) const { return cost < other.cost; }
+	};
+
+	inline unsigned long long edgeKey(GLuint a, GLuint b) {
+		if (a > b) std::swap(a, b);
+		return ((unsigned long long)a << 32) | b;
+	}
+
+	// Checks that moving 'from' onto 'to' does not fold any surviving triangle around 'from' over
+	bool flipsTriangle(const std::vector<Vertex>& vertices, const std::vector<GLuint>& triangles,
+		const std::vector<unsigned int>& adjacency, unsigned int begin, unsigned int end, GLuint from, GLuint to)
+	{
+		const glm::vec3& target = vertices[to].Position;
+		for (unsigned int a = begin; a < end; a++) {
+			const GLuint* t = &triangles[adjacency[a] * 3];
+			if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) continue;
+			if (t[0] == to || t[1] == to || t[2] == to) continue;
+			glm::vec3 p[3], q[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = vertices[t[k]].Position;
+				q[k] = (t[k] == from) ? target : p[k];
+			}
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+			if (glm::dot(before, after) <= 0.0f) return true;
+		}
+		return false;
+	}
+}
+
+std::vector<GLuint> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, size_t targetIndexCount, float maxError)
+{
+	std::vector<GLuint> triangles(indices);
+	size_t vertexCount = vertices.size();
+	if (triangles.size() <= targetIndexCount) return triangles;
+
+	// Vertices sharing a position with another vertex sit on an attribute seam and are locked
+	std::vector<bool> locked(vertexCount, false);
+	std::unordered_map<glm::vec3, GLuint, PositionHash, PositionEqual> firstAtPosition;
+	for (GLuint v = 0; v < vertexCount; v++) {
+		auto inserted = firstAtPosition.insert(std::make_pair(vertices[v].Position, v));
+		if (!inserted.second) {
+			locked[v] = true;
+			locked[inserted.first->second] = true;
+		}
+	}
+
+	// Vertices on open edges are locked so silhouettes of open meshes keep their outline
+	std::unordered_map<unsigned long long, int> edgeUse;
+	for (size_t i = 0; i < triangles.size(); i += 3)
+		for (int k = 0; k < 3; k++)
+			edgeUse[edgeKey(triangles[i + k], triangles[i + (k + 1) % 3])]++;
+	for (auto it = edgeUse.begin(); it != edgeUse.end(); ++it) {
+		if (it->second == 1) {
+			locked[(GLuint)(it->first >> 32)] = true;
+			locked[(GLuint)(it->first & 0xffffffffu)] = true;
+		}
+	}
+
+	// Area-weighted plane quadrics accumulated per vertex
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < triangles.size(); i += 3) {
+		const glm::vec3& p0 = vertices[triangles[i]].Position;
+		const glm::vec3& p1 = vertices[triangles[i + 1]].Position;
+		const glm::vec3& p2 = vertices[triangles[i + 2]].Position;
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(n);
+		if (area == 0.0f) continue;
+		n /= area;
+		Quadric q(n.x, n.y, n.z, -glm::dot(n, p0), area * 0.5);
+		for (int k = 0; k < 3; k++)
+			quadrics[triangles[i + k]].add(q);
+	}
+
+	std::vector<unsigned int> offsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<bool> dirty(vertexCount);
+	std::vector<Collapse> collapses;
+
+	for (int pass = 0; pass < 64 && triangles.size() > targetIndexCount; pass++) {
+		// Rebuild vertex -> triangle adjacency for the surviving triangles
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t i = 0; i < triangles.size(); i++)
+			offsets[triangles[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(triangles.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangles.size(); i++)
+			adjacency[fill[triangles[i]]++] = (unsigned int)(i / 3);
+
+		// Cheapest legal direction for every edge
+		collapses.clear();
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				GLuint a = triangles[i + k];
+				GLuint b = triangles[i + (k + 1) % 3];
+				if (a > b) continue; // each interior edge is seen from both triangles
+				Quadric q = quadrics[a];
+				q.add(quadrics[b]);
+				Collapse c = { a, b, 1e30 };
+				if (!locked[a]) c.cost = q.error(vertices[b].Position);
+				if (!locked[b]) {
+					double cost = q.error(vertices[a].Position);
+					if (cost < c.cost) {
+						c.from = b;
+						c.to = a;
+						c.cost = cost;
+					}
+				}
+				// The cost is area times squared distance; maxError is a squared distance, so scale it by the same area
+				if (c.cost <= maxError * q.w) collapses.push_back(c);
+			}
+		}
+		if (collapses.empty()) break;
+		std::sort(collapses.begin(), collapses.end());
+
+		// Apply non-overlapping collapses in cost order until the target is reached
+		std::fill(dirty.begin(), dirty.end(), false);
+		size_t remaining = triangles.size() / 3;
+		size_t target = targetIndexCount / 3;
+		bool collapsed = false;
+		for (size_t c = 0; c < collapses.size() && remaining > target; c++) {
+			GLuint from = collapses[c].from;
+			GLuint to = collapses[c].to;
+			if (dirty[from] || dirty[to]) continue;
+			if (flipsTriangle(vertices, triangles, adjacency, offsets[from], offsets[from + 1], from, to)) continue;
+
+			for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++) {
+				GLuint* t = &triangles[adjacency[a] * 3];
+				bool wasDegenerate = (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]);
+				for (int k = 0; k < 3; k++) {
+					dirty[t[k]] = true;
+					if (t[k] == from) t[k] = to;
+				}
+				if (!wasDegenerate && (t[0] == t[1] || t[1] == t[2] || t[0] == t[2])) remaining--;
+			}
+			quadrics[to].add(quadrics[from]);
+			collapsed = true;
+		}
+		if (!collapsed) break;
+
+		// Drop triangles that lost an edge
+		size_t write = 0;
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			GLuint a = triangles[i], b = triangles[i + 1], d = triangles[i + 2];
+			if (a == b || b == d || a == d) continue;
+			triangles[write++] = a;
+			triangles[write++] = b;
+			triangles[write++] = d;
+		}
+		triangles.resize(write);
+	}
+	return triangles;
+}
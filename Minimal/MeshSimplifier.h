@@ -0,0 +1,19 @@
+#ifndef _MESH_SIMPLIFIER_H_
+#define _MESH_SIMPLIFIER_H_
+
+#include <vector>
+#include <GL/glew.h>
+#include "Mesh.h"
+
+// Quadric error metric simplification (Garland & Heckbert 1997) restricted to half-edge collapses,
+// so every level of detail indexes into the same vertex buffer as the full-detail mesh.
+class MeshSimplifier
+{
+public:
+	// Returns a triangle list with at most targetIndexCount indices, or fewer collapses if any further
+	// collapse would leave the merged vertex further than sqrt(maxError), as an area-weighted RMS
+	// distance, from the original triangles around it. Boundary and seam vertices never move.
+	static std::vector<GLuint> simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, size_t targetIndexCount, float maxError);
+};
+
+#endif
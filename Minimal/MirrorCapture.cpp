@@ -0,0 +1,153 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <SOIL.h>
+#include "MirrorCapture.h"
+#include "GLState.h"
+
+MirrorCapture::MirrorCapture()
+{
+	format = TGA;
+	prefix = "mirror_";
+	running = false;
+	stopping = false;
+	width = height = 0;
+	next = 0;
+	captured = dropped = 0;
+	for (int i = 0; i < RING; i++) {
+		slots[i].buffer = 0;
+		slots[i].fence = 0;
+	}
+}
+
+MirrorCapture::~MirrorCapture()
+{
+	// Buffers and fences go with the context; only the thread needs stopping here
+	if (!writer.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	writer.join();
+}
+
+void MirrorCapture::start(GLsizei width, GLsizei height)
+{
+	if (running) return;
+	this->width = width;
+	this->height = height;
+	for (int i = 0; i < RING; i++) {
+		glGenBuffers(1, &slots[i].buffer);
+		GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, NULL, GL_STREAM_READ);
+	}
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	next = 0;
+	captured = dropped = 0;
+	stopping = false;
+	writer = std::thread(&MirrorCapture::write, this);
+	running = true;
+	std::cout << "Mirror capture started: " << width << "x" << height << ", "
+		<< prefix << "*" << (format == TGA ? ".tga" : ".raw") << std::endl;
+}
+
+void MirrorCapture::stop()
+{
+	if (!running) return;
+	collect(true);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	writer.join();
+	for (int i = 0; i < RING; i++) {
+		glDeleteBuffers(1, &slots[i].buffer);
+		slots[i].buffer = 0;
+	}
+	GLState::invalidate();
+	running = false;
+	std::cout << "Mirror capture stopped: " << captured << " frames written, " << dropped << " dropped" << std::endl;
+}
+
+void MirrorCapture::frame()
+{
+	if (!running) return;
+	collect(false);
+
+	Slot& slot = slots[next];
+	if (slot.fence) {
+		dropped++;
+		return;
+	}
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)0);
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	next = (next + 1) % RING;
+}
+
+void MirrorCapture::collect(bool wait)
+{
+	// Oldest first, so frames reach the writer in order
+	for (int i = 0; i < RING; i++) {
+		Slot& slot = slots[(next + i) % RING];
+		if (!slot.fence) continue;
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+		if (status == GL_TIMEOUT_EXPIRED) break;
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		Frame frame;
+		frame.number = captured;
+		GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, width * height * 4, GL_MAP_READ_BIT);
+		if (pixels) {
+			frame.pixels.assign(pixels, pixels + width * height * 4);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (frame.pixels.empty() || frames.size() >= MAX_QUEUED) {
+			dropped++;
+			continue;
+		}
+		captured++;
+		frames.push_back(std::move(frame));
+		wake.notify_one();
+	}
+}
+
+void MirrorCapture::write()
+{
+	std::vector<unsigned char> flipped(width * height * 4);
+	size_t stride = width * 4;
+	for (;;) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !frames.empty(); });
+			if (frames.empty()) return;
+			frame = std::move(frames.front());
+			frames.pop_front();
+		}
+
+		// GL reads bottom row first; both formats are written top row first
+		for (GLsizei y = 0; y < height; y++)
+			memcpy(&flipped[y * stride], &frame.pixels[(height - 1 - y) * stride], stride);
+		char name[512];
+		snprintf(name, sizeof(name), "%s%05d%s", prefix.c_str(), frame.number, format == TGA ? ".tga" : ".raw");
+		bool ok;
+		if (format == TGA) {
+			ok = SOIL_save_image(name, SOIL_SAVE_TYPE_TGA, width, height, 4, &flipped[0]) != 0;
+		}
+		else {
+			FILE* file = fopen(name, "wb");
+			ok = file && fwrite(&flipped[0], 1, flipped.size(), file) == flipped.size();
+			if (file) fclose(file);
+		}
+		if (!ok) std::cout << "Mirror capture: could not write " << name << std::endl;
+	}
+}
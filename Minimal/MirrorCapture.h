@@ -0,0 +1,72 @@
+#ifndef _MIRROR_CAPTURE_H_
+#define _MIRROR_CAPTURE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+// Records the mirror image to numbered files without stalling the GPU. Each call to frame()
+// starts an asynchronous glReadPixels into the next pixel pack buffer of a ring; a buffer is mapped
+// only once its fence shows the copy is done, a few frames later, and the copy goes to a writer thread.
+// Frames are dropped, and counted, rather than ever making the render thread wait.
+class MirrorCapture
+{
+public:
+	enum Format {
+		RAW, // bare RGBA8 rows, top row first; the size is in the log
+		TGA  // through SOIL
+	};
+
+	// Pixel pack buffers in flight
+	static const int RING = 3;
+	// Frames allowed to wait for the writer before new ones are dropped
+	static const size_t MAX_QUEUED = 8;
+
+	MirrorCapture();
+	~MirrorCapture();
+
+	Format format;
+	// Files are written as prefix + frame number + extension
+	std::string prefix;
+
+	bool active() const { return running; }
+	void start(GLsizei width, GLsizei height);
+	// Finishes the frames in flight, waits for the writer and frees the buffers
+	void stop();
+	// Captures one frame; call on every mirror frame with the mirror bound as the read framebuffer.
+	// The caller sets the rate, so the files hold exactly the frames the window showed.
+	void frame();
+
+private:
+	struct Slot {
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	struct Frame {
+		int number;
+		std::vector<unsigned char> pixels;
+	};
+
+	bool running;
+	GLsizei width, height;
+	Slot slots[RING];
+	int next;
+	int captured, dropped;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Frame> frames;
+	bool stopping;
+
+	// Maps every slot whose copy has finished and queues its pixels; wait blocks until all have
+	void collect(bool wait);
+	void write();
+};
+
+#endif
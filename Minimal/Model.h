@@ -6,25 +6,31 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <cfloat>
 using namespace std;
 // GL Includes
 #include <GL/glew.h> // Contains all the necessery OpenGL includes
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-// #include <SOIL.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include "Mesh.h"
-
-GLint textureFromFile(const char* path, string directory);
-struct Material;
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Lod.h"
 
 class Model : public Geode
 {
 public:
     glm::mat4 toWorld;
+    // Object-space bounding sphere, used to pick a level of detail from projected size
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    // Triangles in each level of detail, summed over all meshes
+    vector<GLuint> lodTriangles;
     /*  Functions   */
     // Constructor, expects a filepath to a 3D model.
     Model(GLchar* path)
@@ -32,6 +38,17 @@ public:
         this->loadModel(path);
     }
 
+    // Drops the model's references to its textures
+    ~Model()
+    {
+        for(GLuint i = 0; i < this->textureHandles.size(); i++)
+            TextureCache::release(this->textureHandles[i]);
+    }
+
+    // A copy would release the model's TextureCache references a second time
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     // Draws the model, and thus all its meshes
     void draw(GLuint shaderProgram)
     {
@@ -47,8 +64,19 @@ public:
 
 	void draw(glm::mat4 C, GLint shaderProgram, glm::mat4 P, glm::mat4 V)
 	{
+		int lod = this->selectLod(C, P, V);
 		for (GLuint i = 0; i < this->meshes.size(); i++)
-			this->meshes[i].draw(C, shaderProgram, P, V);
+			this->meshes[i].draw(C, shaderProgram, P, V, std::min(lod, (int)this->meshes[i].lodCounts.size() - 1));
+	}
+
+	// Picks the level of detail from the bounding sphere's projected radius in the current view
+	int selectLod(glm::mat4 C, glm::mat4 P, glm::mat4 V)
+	{
+		glm::vec4 center = V * C * glm::vec4(this->boundsCenter, 1.0f);
+		float scale = std::max(glm::length(glm::vec3(C[0])), std::max(glm::length(glm::vec3(C[1])), glm::length(glm::vec3(C[2]))));
+		float distance = std::max(-center.z, 0.01f);
+		float screenSize = this->boundsRadius * scale * P[1][1] / distance;
+		return Lod::select(screenSize, (int)this->lodTriangles.size());
 	}
 
     void update()
@@ -57,11 +85,57 @@ public:
             this->meshes[i].update();
     }
 
+    const vector<Mesh>& getMeshes() const
+    {
+        return this->meshes;
+    }
+
+	// ShaderCache features needed by any of the model's materials
+	unsigned int shaderFeatures() const
+	{
+		unsigned int features = 0;
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			features |= this->meshes[i].shaderFeatures();
+		return features;
+	}
+
+    // Logs ACMR and ATVR for every mesh of an asset in the exporter's order before welding, after welding,
+    // and after MeshOptimizer. Only imports the file, so it can cover assets the scene never loads.
+    static void reportVertexCache(const string& path)
+    {
+        Assimp::Importer rawImporter, weldedImporter;
+        const aiScene* raw = rawImporter.ReadFile(path, aiProcess_Triangulate);
+        const aiScene* welded = weldedImporter.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+        if(!raw || !welded || raw->mNumMeshes != welded->mNumMeshes)
+        {
+            cout << "ERROR::ASSIMP:: " << rawImporter.GetErrorString() << weldedImporter.GetErrorString() << endl;
+            return;
+        }
+        for(GLuint m = 0; m < raw->mNumMeshes; m++)
+        {
+            vector<GLuint> rawIndices = faceIndices(raw->mMeshes[m]);
+            VertexCacheStats exported = MeshOptimizer::analyzeVertexCache(rawIndices, raw->mMeshes[m]->mNumVertices);
+
+            aiMesh* mesh = welded->mMeshes[m];
+            vector<Vertex> vertices(mesh->mNumVertices);
+            for(GLuint i = 0; i < mesh->mNumVertices; i++)
+                vertices[i].Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            vector<GLuint> indices = faceIndices(mesh);
+            VertexCacheStats weldedStats = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+            MeshOptimizer::optimize(vertices, indices);
+            VertexCacheStats optimized = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+            cout << path << " mesh " << m << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, "
+                 << "ACMR " << exported.acmr << " -> " << weldedStats.acmr << " -> " << optimized.acmr
+                 << ", ATVR " << exported.atvr << " -> " << weldedStats.atvr << " -> " << optimized.atvr << endl;
+        }
+    }
+
 private:
     /*  Model Data  */
     vector<Mesh> meshes;
     string directory;
-    vector<Texture> textures_loaded;    // Stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<GLint> textureHandles;    // One entry per TextureCache reference the model holds
+    glm::vec3 boundsMin, boundsMax;
 
     /*  Functions   */
     // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
@@ -69,7 +143,7 @@ private:
     {
         // Read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs);
         // Check for errors
         if(!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -80,7 +154,16 @@ private:
         this->directory = path.substr(0, path.find_last_of('/'));
 
         // Process ASSIMP's root node recursively
+        this->boundsMin = glm::vec3(FLT_MAX);
+        this->boundsMax = glm::vec3(-FLT_MAX);
         this->processNode(scene->mRootNode, scene);
+
+        this->boundsCenter = (this->boundsMin + this->boundsMax) * 0.5f;
+        this->boundsRadius = glm::length(this->boundsMax - this->boundsMin) * 0.5f;
+        cout << this->directory << " LOD triangles:";
+        for(GLuint i = 0; i < this->lodTriangles.size(); i++)
+            cout << " " << this->lodTriangles[i];
+        cout << endl;
     }
 
     // Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -102,6 +185,19 @@ private:
 
     }
 
+    // Walks through each of the mesh's faces (a face is a mesh its triangle) and retrieves the corresponding vertex indices.
+    static vector<GLuint> faceIndices(const aiMesh* mesh)
+    {
+        vector<GLuint> indices;
+        for(GLuint i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            for(GLuint j = 0; j < face.mNumIndices; j++)
+                indices.push_back(face.mIndices[j]);
+        }
+        return indices;
+    }
+
     Mesh processMesh(aiMesh* mesh, const aiScene* scene)
     {
         // Data to fill
@@ -138,32 +234,54 @@ private:
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
             vertices.push_back(vertex);
         }
-        // Now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(GLuint i = 0; i < mesh->mNumFaces; i++)
+        indices = faceIndices(mesh);
+        // Reorder for the post-transform cache, overdraw and vertex fetch (reportVertexCache measures the gain)
+        MeshOptimizer::optimize(vertices, indices);
+
+        // Build the level of detail chain. Every level indexes the same vertices and is appended to indices.
+        glm::vec3 meshMin(FLT_MAX), meshMax(-FLT_MAX);
+        for(GLuint i = 0; i < vertices.size(); i++)
         {
-            aiFace face = mesh->mFaces[i];
-            // Retrieve all indices of the face and store them in the indices vector
-            for(GLuint j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            meshMin = glm::min(meshMin, vertices[i].Position);
+            meshMax = glm::max(meshMax, vertices[i].Position);
+        }
+        this->boundsMin = glm::min(this->boundsMin, meshMin);
+        this->boundsMax = glm::max(this->boundsMax, meshMax);
+        float meshRadius = glm::length(meshMax - meshMin) * 0.5f;
+        vector<GLuint> lodCounts(1, (GLuint)indices.size());
+        vector<GLuint> previous = indices;
+        for(int lod = 1; lod < Lod::MAX_LODS; lod++)
+        {
+            // Allowed surface deviation doubles with every level, starting at 1% of the mesh radius
+            float maxDeviation = 0.01f * (float)(1 << (lod - 1)) * meshRadius;
+            vector<GLuint> simplified = MeshSimplifier::simplify(vertices, previous, indices.size() >> lod, maxDeviation * maxDeviation);
+            if(simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+                break;
+            vector<size_t> clusters;
+            MeshOptimizer::optimizeVertexCache(simplified, vertices.size(), clusters);
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            lodCounts.push_back((GLuint)simplified.size());
+            previous.swap(simplified);
+        }
+        for(GLuint i = 0; i < lodCounts.size(); i++)
+        {
+            if(this->lodTriangles.size() <= i)
+                this->lodTriangles.push_back(0);
+            this->lodTriangles[i] += lodCounts[i] / 3;
         }
         // Process materials
         Material meshMaterial;
+        meshMaterial.diffuseTexture = -1;
         if(mesh->mMaterialIndex >= 0)
         {
             aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-            // We assume a convention for sampler names in the shaders. Each diffuse texture should be named
-            // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-            // Same applies to other texture as the following list summarizes:
-            // Diffuse: texture_diffuseN
-            // Specular: texture_specularN
-            // Normal: texture_normalN
-
-            // 1. Diffuse maps
-            //vector<Texture> diffuseMaps = this->loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-            //textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            // 2. Specular maps
-            //vector<Texture> specularMaps = this->loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-            //textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+            // Textures come from the shared TextureCache and load in the background. The first diffuse map
+            // becomes the material's. Specular maps are not loaded: no shader samples them, so they would
+            // only cost decode time, uploads and VRAM.
+            vector<Texture> diffuseMaps = this->loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+            if(!diffuseMaps.empty())
+                meshMaterial.diffuseTexture = diffuseMaps[0].handle;
 
             aiColor3D diffuse (0.f,0.f,0.f);
             material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
@@ -180,12 +298,13 @@ private:
         }
 
         // Return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures, meshMaterial);
+        Mesh result(vertices, indices, textures, meshMaterial, lodCounts);
+        result.closed = MeshOptimizer::isClosed(vertices, vector<GLuint>(indices.begin(), indices.begin() + lodCounts[0]));
+        return result;
     }
 
-    // Checks all material textures of a given type and loads the textures if they're not loaded yet.
+    // Looks up every texture of a given type through the TextureCache, queueing the ones no model has loaded yet.
     // The required info is returned as a Texture struct.
-	/*
     vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
@@ -193,54 +312,13 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // Check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            GLboolean skip = false;
-            for(GLuint j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.C_Str(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // A texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // If texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = textureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str;
-                textures.push_back(texture);
-                this->textures_loaded.push_back(texture);  // Store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.handle = TextureCache::acquire(this->directory + '/' + str.C_Str());
+            this->textureHandles.push_back(texture.handle);
+            texture.type = typeName;
+            texture.path = str;
+            textures.push_back(texture);
         }
         return textures;
     }
-	*/
 };
-
-/*
-GLint textureFromFile(const char* path, string directory)
-{
-     //Generate texture ID and load texture data
-    string filename = string(path);
-    filename = directory + '/' + filename;
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    int width,height;
-    unsigned char* image = SOIL_load_image(filename.c_str(), &width, &height, 0, SOIL_LOAD_RGB);
-    // Assign texture to ID
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // Parameters
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    SOIL_free_image_data(image);
-    return textureID;
-}
-*/
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include <unordered_map>
+#include "MoleculeImpostor.h"
+#include "MeshOptimizer.h"
+#include "GLState.h"
+
+// Per-instance layout: sphere centre and radius, ambient, diffuse, specular and shininess
+static const int INSTANCE_FLOATS = 4 + 3 + 3 + 4;
+
+// A piece counts as a sphere when every vertex lies within this fraction of the radius from its surface
+static const float SPHERE_TOLERANCE = 0.1f;
+
+static const GLfloat quadCorners[4][2] = {
+	{-1.0f, -1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}, {1.0f, 1.0f}
+};
+
+namespace {
+	GLuint findRoot(std::vector<GLuint>& parent, GLuint v) {
+		while (parent[v] != v) {
+			parent[v] = parent[parent[v]];
+			v = parent[v];
+		}
+		return v;
+	}
+}
+
+MoleculeImpostor::MoleculeImpostor(const Model* model)
+{
+	const vector<Mesh>& meshes = model->getMeshes();
+	for (size_t i = 0; i < meshes.size(); i++)
+		extract(meshes[i]);
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &quadVBO);
+	glGenBuffers(1, &instanceVBO);
+
+	GLState::bindVertexArray(VAO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, quadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quadCorners), quadCorners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
+
+	// Everything else advances once per atom instead of once per vertex
+	GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	GLsizei stride = INSTANCE_FLOATS * sizeof(GLfloat);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(4 * sizeof(GLfloat)));
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(7 * sizeof(GLfloat)));
+	glVertexAttribDivisor(3, 1);
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(10 * sizeof(GLfloat)));
+	glVertexAttribDivisor(4, 1);
+
+	std::cout << "Molecule impostor: " << atoms.size() << " atoms, " << bonds.size() << " bond meshes" << std::endl;
+}
+
+MoleculeImpostor::~MoleculeImpostor()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &quadVBO);
+	glDeleteBuffers(1, &instanceVBO);
+	GLState::invalidate();
+}
+
+void MoleculeImpostor::extract(const Mesh& mesh)
+{
+	// Split the mesh into connected pieces, treating vertices at the same position as connected
+	const vector<Vertex>& vertices = mesh.vertices;
+	std::vector<GLuint> parent(vertices.size());
+	std::unordered_map<glm::vec3, GLuint, PositionHash, PositionEqual> firstAtPosition;
+	for (GLuint v = 0; v < vertices.size(); v++) {
+		parent[v] = v;
+		auto inserted = firstAtPosition.insert(std::make_pair(vertices[v].Position, v));
+		if (!inserted.second) parent[v] = inserted.first->second;
+	}
+	GLuint lod0Count = mesh.lodCounts[0];
+	for (GLuint i = 0; i < lod0Count; i += 3) {
+		GLuint a = findRoot(parent, mesh.indices[i]);
+		for (int k = 1; k < 3; k++) {
+			GLuint b = findRoot(parent, mesh.indices[i + k]);
+			if (a != b) parent[b] = a;
+		}
+	}
+
+	std::unordered_map<GLuint, std::vector<GLuint> > pieces;
+	for (GLuint i = 0; i < lod0Count; i += 3)
+		pieces[findRoot(parent, mesh.indices[i])].push_back(i);
+
+	std::vector<Vertex> bondVertices;
+	std::vector<GLuint> bondIndices;
+	std::unordered_map<GLuint, GLuint> bondRemap;
+	for (auto it = pieces.begin(); it != pieces.end(); ++it) {
+		const std::vector<GLuint>& faces = it->second;
+		glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+		for (size_t f = 0; f < faces.size(); f++) {
+			for (int k = 0; k < 3; k++) {
+				const glm::vec3& p = vertices[mesh.indices[faces[f] + k]].Position;
+				minPos = glm::min(minPos, p);
+				maxPos = glm::max(maxPos, p);
+			}
+		}
+		glm::vec3 center = (minPos + maxPos) * 0.5f;
+		glm::vec3 extent = (maxPos - minPos) * 0.5f;
+		float radius = (extent.x + extent.y + extent.z) / 3.0f;
+		bool isSphere = faces.size() >= 8 && radius > 0.0f;
+		for (size_t f = 0; f < faces.size() && isSphere; f++) {
+			for (int k = 0; k < 3; k++) {
+				float d = glm::length(vertices[mesh.indices[faces[f] + k]].Position - center);
+				if (fabs(d - radius) > SPHERE_TOLERANCE * radius) isSphere = false;
+			}
+		}
+
+		if (isSphere) {
+			Atom atom;
+			atom.center = center;
+			atom.radius = radius;
+			atom.material = mesh.material;
+			atoms.push_back(atom);
+			continue;
+		}
+		for (size_t f = 0; f < faces.size(); f++) {
+			for (int k = 0; k < 3; k++) {
+				GLuint v = mesh.indices[faces[f] + k];
+				auto inserted = bondRemap.insert(std::make_pair(v, (GLuint)bondVertices.size()));
+				if (inserted.second) bondVertices.push_back(vertices[v]);
+				bondIndices.push_back(inserted.first->second);
+			}
+		}
+	}
+	if (!bondIndices.empty())
+		bonds.push_back(Mesh(bondVertices, bondIndices, mesh.textures, mesh.material));
+}
+
+void MoleculeImpostor::drawAtoms(const std::vector<glm::mat4>& instances, GLint shaderProgram, glm::mat4 P, glm::mat4 V)
+{
+	if (atoms.empty() || instances.empty()) return;
+
+	instanceData.clear();
+	for (size_t i = 0; i < instances.size(); i++) {
+		const glm::mat4& M = instances[i];
+		float scale = glm::length(glm::vec3(M[0]));
+		for (size_t a = 0; a < atoms.size(); a++) {
+			const Atom& atom = atoms[a];
+			glm::vec4 center = M * glm::vec4(atom.center, 1.0f);
+			const Material& m = atom.material;
+			GLfloat data[INSTANCE_FLOATS] = {
+				center.x, center.y, center.z, atom.radius * scale,
+				m.ambient.r, m.ambient.g, m.ambient.b,
+				m.diffuse.r, m.diffuse.g, m.diffuse.b,
+				m.specular.r, m.specular.g, m.specular.b, m.shininess
+			};
+			instanceData.insert(instanceData.end(), data, data + INSTANCE_FLOATS);
+		}
+	}
+
+	GLState::useProgram(shaderProgram);
+	GLState::uniformMatrix4fv("projection", &P[0][0]);
+	GLState::uniformMatrix4fv("model", &V[0][0]);
+
+	// Orphan the previous frame's data so the driver does not have to wait for it
+	GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instanceData.size() * sizeof(GLfloat), &instanceData[0]);
+
+	GLState::bindVertexArray(VAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)(instanceData.size() / INSTANCE_FLOATS));
+}
+
+void MoleculeImpostor::drawBonds(const std::vector<glm::mat4>& instances, GLint shaderProgram, glm::mat4 P, glm::mat4 V)
+{
+	for (size_t b = 0; b < bonds.size(); b++)
+		bonds[b].drawInstanced(instances, shaderProgram, P, V);
+}
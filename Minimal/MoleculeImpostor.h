@@ -0,0 +1,39 @@
+#ifndef _MOLECULE_IMPOSTOR_H_
+#define _MOLECULE_IMPOSTOR_H_
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Model.h"
+
+struct Atom {
+	glm::vec3 center; // object space
+	float radius;
+	Material material;
+};
+
+// Alternate renderer for ball-and-stick models. Every sphere-shaped piece of the model becomes an
+// Atom drawn as a camera-facing quad that ray-casts the exact sphere (impostor.vert/impostor.frag).
+// Everything else (the sticks) is kept as ordinary meshes.
+class MoleculeImpostor
+{
+public:
+	MoleculeImpostor(const Model* model);
+	~MoleculeImpostor();
+
+	std::vector<Atom> atoms;
+	std::vector<Mesh> bonds;
+
+	// instances are the object-to-world transforms of every copy of the molecule
+	void drawAtoms(const std::vector<glm::mat4>& instances, GLint shaderProgram, glm::mat4 P, glm::mat4 V);
+	// Bonds are drawn instanced, so shaderProgram must be a ShaderCache::INSTANCED variant
+	void drawBonds(const std::vector<glm::mat4>& instances, GLint shaderProgram, glm::mat4 P, glm::mat4 V);
+
+private:
+	GLuint VAO, quadVBO, instanceVBO;
+	std::vector<GLfloat> instanceData;
+
+	void extract(const Mesh& mesh);
+};
+
+#endif
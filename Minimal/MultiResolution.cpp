@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include "MultiResolution.h"
+#include "ShaderCache.h"
+#include "GLState.h"
+
+const float MultiResolution::CENTER = 0.6f;
+const float MultiResolution::PERIPHERY_SCALE = 0.5f;
+
+MultiResolution::MultiResolution()
+{
+	enabled = false;
+	fbo = 0;
+	colorTexture = 0;
+	vao = 0;
+}
+
+MultiResolution::~MultiResolution()
+{
+	if (!fbo) return;
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &colorTexture);
+	glDeleteVertexArrays(1, &vao);
+	GLState::invalidate();
+}
+
+void MultiResolution::init(glm::uvec2 size, GLuint depthBuffer)
+{
+	this->size = size;
+	glGenTextures(1, &colorTexture);
+	GLState::bindTextureForUpdate(0, GL_TEXTURE_2D, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	// The resolve quad comes from gl_VertexID, but core profile still needs a VAO bound to draw
+	glGenVertexArrays(1, &vao);
+}
+
+static ovrRecti rect(int x, int y, int w, int h)
+{
+	ovrRecti r;
+	r.Pos.x = x;
+	r.Pos.y = y;
+	r.Size.w = std::max(1, w);
+	r.Size.h = std::max(1, h);
+	return r;
+}
+
+void MultiResolution::layout(const ovrFovPort& fov, const ovrRecti& viewport, MultiResRegion regions[REGIONS])
+{
+	float l = -fov.LeftTan, r = fov.RightTan, b = -fov.DownTan, t = fov.UpTan;
+	float cl = l * CENTER, cr = r * CENTER, cb = b * CENTER, ct = t * CENTER;
+
+	// The eye projection is linear in tangent space, so every region is a rectangle of the eye viewport.
+	// Edges are rounded once so neighbouring regions share them exactly.
+	int W = viewport.Size.w, H = viewport.Size.h;
+	int x1 = (int)floorf((cl - l) / (r - l) * W + 0.5f);
+	int x2 = (int)floorf((cr - l) / (r - l) * W + 0.5f);
+	int y1 = (int)floorf((cb - b) / (t - b) * H + 0.5f);
+	int y2 = (int)floorf((ct - b) / (t - b) * H + 0.5f);
+	int px = viewport.Pos.x, py = viewport.Pos.y;
+	float s = PERIPHERY_SCALE;
+
+	MultiResRegion centre = { cl, cr, cb, ct };
+	centre.target = rect(px + x1, py + y1, x2 - x1, y2 - y1);
+	MultiResRegion left = { l, cl, cb, ct };
+	left.target = rect(px, py + y1, x1, y2 - y1);
+	MultiResRegion right = { cr, r, cb, ct };
+	right.target = rect(px + x2, py + y1, W - x2, y2 - y1);
+	MultiResRegion bottom = { l, r, b, cb };
+	bottom.target = rect(px, py, W, y1);
+	MultiResRegion top = { l, r, ct, t };
+	top.target = rect(px, py + y2, W, H - y2);
+
+	// Packed: centre, left and right along the bottom row, then the bottom and top strips above them
+	centre.source = centre.target;
+	centre.source.Pos.x = px;
+	centre.source.Pos.y = py;
+	left.source = rect(px + centre.source.Size.w, py, (int)(left.target.Size.w * s + 0.5f), (int)(left.target.Size.h * s + 0.5f));
+	right.source = rect(left.source.Pos.x + left.source.Size.w, py, (int)(right.target.Size.w * s + 0.5f), (int)(right.target.Size.h * s + 0.5f));
+	bottom.source = rect(px, py + centre.source.Size.h, (int)(W * s + 0.5f), (int)(bottom.target.Size.h * s + 0.5f));
+	top.source = rect(px + bottom.source.Size.w, py + centre.source.Size.h, (int)(W * s + 0.5f), (int)(top.target.Size.h * s + 0.5f));
+
+	regions[0] = centre;
+	regions[1] = left;
+	regions[2] = right;
+	regions[3] = bottom;
+	regions[4] = top;
+}
+
+glm::mat4 MultiResolution::projection(const MultiResRegion& region, float nearPlane, float farPlane)
+{
+	return glm::frustum(region.left * nearPlane, region.right * nearPlane, region.bottom * nearPlane, region.top * nearPlane, nearPlane, farPlane);
+}
+
+void MultiResolution::resolve(const MultiResRegion regions[REGIONS])
+{
+	GLint program = ShaderCache::get("multires.vert", "multires.frag");
+	if (!program) return;
+	GLState::useProgram(program);
+	GLState::bindTexture(0, GL_TEXTURE_2D, colorTexture);
+	GLState::bindVertexArray(vao);
+	GLState::setEnabled(GL_CULL_FACE, false);
+	GLState::uniform1i("source", 0);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	for (int i = 0; i < REGIONS; i++) {
+		const ovrRecti& s = regions[i].source;
+		const ovrRecti& t = regions[i].target;
+		glViewport(t.Pos.x, t.Pos.y, t.Size.w, t.Size.h);
+		GLState::uniform4f("sourceRect", (GLfloat)s.Pos.x / size.x, (GLfloat)s.Pos.y / size.y,
+			(GLfloat)(s.Pos.x + s.Size.w) / size.x, (GLfloat)(s.Pos.y + s.Size.h) / size.y);
+		GLState::uniform2f("texelSize", 1.0f / size.x, 1.0f / size.y);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
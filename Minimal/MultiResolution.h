@@ -0,0 +1,51 @@
+#ifndef _MULTI_RESOLUTION_H_
+#define _MULTI_RESOLUTION_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <OVR_CAPI.h>
+
+// One part of an eye's field of view, rendered on its own with an off-centre projection
+struct MultiResRegion {
+	// Bounds as tangents of the view angle, as in ovrFovPort (left and bottom negative)
+	float left, right, bottom, top;
+	// Where the region is rendered in the packed target, and where it lands in the eye viewport
+	ovrRecti source;
+	ovrRecti target;
+};
+
+// Multi-resolution eye rendering. Each eye's FOV is split into a centre region rendered at full pixel
+// density and four border strips (left, right, and full-width bottom and top) at PERIPHERY_SCALE,
+// where the lens distortion undersamples the eye buffer anyway. The regions are packed into an
+// offscreen target the size of the swap chain texture; resolve() stretches them back into place.
+class MultiResolution
+{
+public:
+	static const int REGIONS = 5;
+	// Fraction of each half-FOV, in tangent space, covered by the centre region
+	static const float CENTER;
+	// Pixel density of the border strips. At most 0.5, or the packed regions no longer fit in the eye's area.
+	static const float PERIPHERY_SCALE;
+
+	MultiResolution();
+	~MultiResolution();
+
+	bool enabled;
+
+	// Creates the packed colour target; depthBuffer must be at least size and is shared with the caller's framebuffer
+	void init(glm::uvec2 size, GLuint depthBuffer);
+	GLuint framebuffer() const { return fbo; }
+
+	// Splits an eye, given its FOV and its viewport in the swap chain texture, into regions packed at the same origin
+	static void layout(const ovrFovPort& fov, const ovrRecti& viewport, MultiResRegion regions[REGIONS]);
+	static glm::mat4 projection(const MultiResRegion& region, float nearPlane, float farPlane);
+
+	// Draws one eye's regions from the packed target into their place in the bound draw framebuffer
+	void resolve(const MultiResRegion regions[REGIONS]);
+
+private:
+	GLuint fbo, colorTexture, vao;
+	glm::uvec2 size;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <iostream>
+#include "ResolutionScaler.h"
+
+const float ResolutionScaler::MIN_SCALE = 0.6f;
+const float ResolutionScaler::STEP = 0.05f;
+const float ResolutionScaler::LOWER_ABOVE = 0.95f;
+const float ResolutionScaler::RAISE_BELOW = 0.75f;
+
+ResolutionScaler::ResolutionScaler()
+{
+	scale = 1.0f;
+	enabled = true;
+	current = 0;
+	budget = 1000.0f / 90.0f;
+	gpuTime = 0.0f;
+	overFrames = 0;
+	underFrames = 0;
+	reports = 0;
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		queries[i] = 0;
+		pending[i] = false;
+	}
+}
+
+ResolutionScaler::~ResolutionScaler()
+{
+	if (queries[0]) glDeleteQueries(QUERY_FRAMES, queries);
+}
+
+void ResolutionScaler::setBudget(float milliseconds)
+{
+	budget = milliseconds;
+}
+
+void ResolutionScaler::beginFrame()
+{
+	if (!queries[0]) glGenQueries(QUERY_FRAMES, queries);
+	// Only happens if the GPU is QUERY_FRAMES behind; skip timing this frame rather than wait
+	if (pending[current]) return;
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void ResolutionScaler::endFrame()
+{
+	if (!pending[current]) {
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[current] = true;
+		current = (current + 1) % QUERY_FRAMES;
+	}
+
+	// Oldest first, stopping at the first one that has not finished
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		int q = (current + i) % QUERY_FRAMES;
+		if (!pending[q]) continue;
+		GLuint available = 0;
+		glGetQueryObjectuiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &nanoseconds);
+		pending[q] = false;
+		adjust(nanoseconds / 1.0e6f);
+	}
+}
+
+void ResolutionScaler::adjust(float milliseconds)
+{
+	// Light smoothing so one slow frame (a shader finishing, a texture upload) does not move the scale
+	gpuTime = gpuTime > 0.0f ? gpuTime * 0.7f + milliseconds * 0.3f : milliseconds;
+	if (!enabled) {
+		scale = 1.0f;
+		overFrames = underFrames = 0;
+		return;
+	}
+
+	overFrames = gpuTime > budget * LOWER_ABOVE ? overFrames + 1 : 0;
+	underFrames = gpuTime < budget * RAISE_BELOW ? underFrames + 1 : 0;
+	float previous = scale;
+	if (overFrames >= LOWER_FRAMES) {
+		scale = std::max(MIN_SCALE, scale - STEP);
+		overFrames = 0;
+	}
+	else if (underFrames >= RAISE_FRAMES) {
+		scale = std::min(1.0f, scale + STEP);
+		underFrames = 0;
+	}
+	if (scale != previous || ++reports % 450 == 0)
+		std::cout << "Resolution scale " << scale << " (GPU " << gpuTime << " ms, budget " << budget << " ms)" << std::endl;
+}
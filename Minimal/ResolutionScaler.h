@@ -0,0 +1,51 @@
+#ifndef _RESOLUTION_SCALER_H_
+#define _RESOLUTION_SCALER_H_
+
+#include <GL/glew.h>
+
+// Dynamic resolution. Times the GPU work of every frame with GL_TIME_ELAPSED queries, read back a few
+// frames late so nothing waits, and turns the result into a scale for the eye viewports: down quickly
+// when frames run over budget, back up slowly once there is clear headroom.
+class ResolutionScaler
+{
+public:
+	// Frames a timer query has to complete before it is read
+	static const int QUERY_FRAMES = 4;
+	static const float MIN_SCALE;
+	static const float STEP;
+	// Fractions of the budget above which the scale drops and below which it may rise
+	static const float LOWER_ABOVE;
+	static const float RAISE_BELOW;
+	// Consecutive frames the condition must hold before the scale moves
+	static const int LOWER_FRAMES = 3;
+	static const int RAISE_FRAMES = 45;
+
+	ResolutionScaler();
+	~ResolutionScaler();
+
+	// Scale applied to both viewport dimensions, MIN_SCALE to 1
+	float scale;
+	// When false the scale is held at 1
+	bool enabled;
+
+	// GPU milliseconds a frame may take
+	void setBudget(float milliseconds);
+	// Smoothed GPU milliseconds of recent frames
+	float gpuMilliseconds() const { return gpuTime; }
+	// Bracket the frame's rendering; endFrame also reads finished queries and updates scale
+	void beginFrame();
+	void endFrame();
+
+private:
+	GLuint queries[QUERY_FRAMES];
+	bool pending[QUERY_FRAMES];
+	int current;
+	float budget;
+	float gpuTime;
+	int overFrames, underFrames;
+	int reports;
+
+	void adjust(float milliseconds);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <sstream>
+#include "ShaderCache.h"
+#include "GLState.h"
+
+std::map<ShaderCache::VariantKey, GLint> ShaderCache::resolved;
+std::map<std::string, GLint> ShaderCache::programs;
+std::map<std::string, ShaderBuild> ShaderCache::builds;
+bool ShaderCache::blocking = false;
+
+std::string ShaderCache::defines(unsigned int features, int lightCount)
+{
+	std::string result;
+	if (features & TEXTURED) result += "#define TEXTURED\n";
+	if (features & UNLIT) result += "#define UNLIT\n";
+	if (features & INSTANCED) result += "#define INSTANCED\n";
+	if (features & CLUSTERED) result += "#define CLUSTERED\n";
+	if (features & OVERDRAW) result += "#define OVERDRAW\n";
+	if (!(features & (UNLIT | CLUSTERED | OVERDRAW))) result += "#define NUM_POINT_LIGHTS " + std::to_string(lightCount) + "\n";
+	return result;
+}
+
+std::string ShaderCache::key(const char* vertexName, const char* fragmentName, const std::string& variantDefines)
+{
+	return std::string(vertexName) + "|" + fragmentName + "|" + variantDefines;
+}
+
+bool ShaderCache::VariantKey::operator<(const VariantKey& other) const
+{
+	if (vertexName != other.vertexName) return vertexName < other.vertexName;
+	if (fragmentName != other.fragmentName) return fragmentName < other.fragmentName;
+	if (features != other.features) return features < other.features;
+	return lightCount < other.lightCount;
+}
+
+GLint ShaderCache::get(const char* vertexName, const char* fragmentName, unsigned int features, int lightCount)
+{
+	// Called for every draw, so the common case is one lookup on a small POD key
+	VariantKey fastKey = { vertexName, fragmentName, features, (features & (UNLIT | CLUSTERED | OVERDRAW)) ? 0 : lightCount };
+	auto hit = resolved.find(fastKey);
+	if (hit != resolved.end()) return hit->second;
+
+	std::string variantDefines = defines(features, lightCount);
+	std::string variantKey = key(vertexName, fragmentName, variantDefines);
+	auto found = programs.find(variantKey);
+	GLint program;
+	if (found != programs.end()) {
+		program = found->second;
+	} else {
+		auto build = builds.find(variantKey);
+		if (build == builds.end())
+			build = builds.insert(std::make_pair(variantKey, SubmitShaders(vertexName, fragmentName, variantDefines))).first;
+		// Still compiling: skip the draw rather than stall the frame; the fast key stays unset until it is done
+		if (!blocking && !ShaderBuildReady(build->second)) return 0;
+		program = finish(build);
+	}
+	resolved[fastKey] = program;
+	return program;
+}
+
+void ShaderCache::request(const char* vertexName, const char* fragmentName, unsigned int features, int lightCount)
+{
+	std::string variantDefines = defines(features, lightCount);
+	std::string variantKey = key(vertexName, fragmentName, variantDefines);
+	if (programs.count(variantKey) || builds.count(variantKey)) return;
+	builds.insert(std::make_pair(variantKey, SubmitShaders(vertexName, fragmentName, variantDefines)));
+}
+
+void ShaderCache::poll()
+{
+	auto it = builds.begin();
+	while (it != builds.end()) {
+		if (ShaderBuildReady(it->second)) finish(it++);
+		else ++it;
+	}
+}
+
+size_t ShaderCache::pending()
+{
+	return builds.size();
+}
+
+GLint ShaderCache::finish(std::map<std::string, ShaderBuild>::iterator build)
+{
+	GLint program = FinishShaders(build->second);
+	if (!program) {
+		std::cout << "Shader variant failed: " << build->second.fragmentName << std::endl;
+		// Kept as 0, so a failure that poll() finished is not submitted again by the next get()
+		programs[build->first] = 0;
+		builds.erase(build);
+		return 0;
+	}
+	programs[build->first] = program;
+	// The defines are the last part of the key; print them as one line of names
+	std::string label;
+	std::istringstream lines(build->first.substr(build->first.rfind('|') + 1));
+	std::string line;
+	while (std::getline(lines, line))
+		label += (label.empty() ? "" : " ") + line.substr(line.find(' ') + 1);
+	std::cout << "Shader variant " << programs.size() << " ready: " << build->second.fragmentName << " [" << label << "]" << std::endl;
+	builds.erase(build);
+	return program;
+}
+
+size_t ShaderCache::size()
+{
+	return programs.size();
+}
+
+void ShaderCache::clear()
+{
+	for (auto it = builds.begin(); it != builds.end(); ++it) {
+		FinishShaders(it->second);
+		glDeleteProgram(it->second.program);
+	}
+	builds.clear();
+	for (auto it = programs.begin(); it != programs.end(); ++it)
+		if (it->second) glDeleteProgram(it->second);
+	programs.clear();
+	resolved.clear();
+	GLState::invalidate();
+}
@@ -0,0 +1,62 @@
+#ifndef _SHADER_CACHE_H_
+#define _SHADER_CACHE_H_
+
+#include <map>
+#include <string>
+#include <GL/glew.h>
+#include "shader.h"
+
+// Shader permutations built on demand. A variant is one vertex/fragment source pair compiled with a
+// set of #defines; it is compiled the first time it is asked for and kept until clear(). Draws skip
+// a variant until it has linked, unless blocking is set.
+// Variants known in advance can be requested up front, so they compile in parallel while the caller
+// does other work; poll() picks up the finished ones without blocking.
+class ShaderCache
+{
+public:
+	enum Feature {
+		TEXTURED = 1 << 0,  // modulate the diffuse colour with a TextureCache layer
+		UNLIT = 1 << 1,     // flat material colour; no normals and no lights
+		INSTANCED = 1 << 2, // world matrix from a per-instance attribute instead of the view uniform
+		CLUSTERED = 1 << 3, // lights from ClusteredLights instead of the pointLight array
+		OVERDRAW = 1 << 4   // flat overdraw colour (as overdraw.frag) for shaders that cannot be swapped for it
+	};
+
+	// lightCount sizes the pointLight array (NUM_POINT_LIGHTS) and is ignored by UNLIT, CLUSTERED and OVERDRAW variants.
+	// Returns 0 while the variant is still compiling, submitting it first if it was never requested,
+	// so callers skip the draw for a frame or two instead of stalling on the link.
+	// Also returns 0 if it failed to build; the failure is remembered, so it is not built again.
+	static GLint get(const char* vertexName, const char* fragmentName, unsigned int features = 0, int lightCount = 0);
+	// While set, get() waits for a variant that is still compiling instead of returning 0. The warm-up
+	// sets it, so every pass it draws links its variant there rather than in the first frames.
+	static bool blocking;
+	// Submits the variant's compile and link and returns at once
+	static void request(const char* vertexName, const char* fragmentName, unsigned int features = 0, int lightCount = 0);
+	// Finishes every requested variant that is ready; call once per frame
+	static void poll();
+	static size_t pending();
+	static std::string defines(unsigned int features, int lightCount);
+	static size_t size();
+	// Deletes every program; call while the context that built them is still current
+	static void clear();
+
+private:
+	// Identifies a variant by the caller's name pointers, so get() can skip building the string key.
+	// Callers pass string literals; the same name at another address just takes the slow path once.
+	struct VariantKey {
+		const char* vertexName;
+		const char* fragmentName;
+		unsigned int features;
+		int lightCount;
+		bool operator<(const VariantKey& other) const;
+	};
+
+	static std::map<VariantKey, GLint> resolved;
+	static std::map<std::string, GLint> programs;
+	static std::map<std::string, ShaderBuild> builds;
+
+	static std::string key(const char* vertexName, const char* fragmentName, const std::string& variantDefines);
+	static GLint finish(std::map<std::string, ShaderBuild>::iterator build);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size lock-free queue for exactly one producer thread and one consumer thread. Each index is
+// written by one side only; the release store that publishes it makes the slot contents visible to
+// the acquire load on the other side. One slot is left empty to tell full from empty.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+	SpscQueue() : head(0), tail(0) {}
+
+	// Producer only; false when the queue is full
+	bool push(const T& value) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t next = (t + 1) % Capacity;
+		if (next == head.load(std::memory_order_acquire)) return false;
+		items[t] = value;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only; false when the queue is empty
+	bool pop(T& value) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		value = items[h];
+		head.store((h + 1) % Capacity, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T items[Capacity];
+	std::atomic<size_t> head; // next slot to pop
+	std::atomic<size_t> tail; // next slot to push
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "TextureCache.h"
+#include "GLState.h"
+
+std::vector<TextureCache::Entry> TextureCache::entries;
+std::unordered_map<std::string, int> TextureCache::handles;
+std::map<std::tuple<GLenum, int, int, int>, std::vector<TextureCache::Array> > TextureCache::arrays;
+TextureLayer TextureCache::placeholder = { 0, 0 };
+GLuint TextureCache::stagingBuffer = 0;
+std::deque<int> TextureCache::uploads;
+
+std::vector<std::thread> TextureCache::workers;
+std::mutex TextureCache::mutex;
+std::condition_variable TextureCache::wake;
+std::deque<std::pair<int, std::string> > TextureCache::jobs;
+std::vector<TextureCache::Decoded> TextureCache::decoded;
+bool TextureCache::stopping = false;
+
+int TextureCache::acquire(const std::string& path)
+{
+	auto found = handles.find(path);
+	if (found != handles.end()) {
+		entries[found->second].references++;
+		return found->second;
+	}
+
+	if (workers.empty()) {
+		DetectCompressedTextureSupport();
+		for (int i = 0; i < WORKER_THREADS; i++)
+			workers.push_back(std::thread(work));
+	}
+
+	// Reuse a free slot; one still waiting for its decode stays DECODING until update() sees the result
+	int handle = 0;
+	while (handle < (int)entries.size() && entries[handle].state != FREE) handle++;
+	if (handle == (int)entries.size()) entries.push_back(Entry());
+	Entry& entry = entries[handle];
+	entry.path = path;
+	entry.state = DECODING;
+	entry.references = 1;
+	entry.texture = placeholder;
+	handles[path] = handle;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	jobs.push_back(std::make_pair(handle, path));
+	wake.notify_one();
+	return handle;
+}
+
+void TextureCache::release(int handle)
+{
+	if (handle < 0 || handle >= (int)entries.size() || entries[handle].references <= 0) return;
+	Entry& entry = entries[handle];
+	if (--entry.references > 0) return;
+	handles.erase(entry.path);
+	if (entry.state != DECODING) unload(entry);
+}
+
+void TextureCache::unload(Entry& entry)
+{
+	if (entry.state == UPLOADING || entry.state == RESIDENT) releaseLayer(entry.texture);
+	if (entry.state == UPLOADING) uploads.erase(std::find(uploads.begin(), uploads.end(), (int)(&entry - &entries[0])));
+	entry.image = TextureData();
+	entry.state = FREE;
+}
+
+TextureLayer TextureCache::layer(int handle)
+{
+	if (!placeholder.array) {
+		static const unsigned char white[4] = { 255, 255, 255, 255 };
+		glGenTextures(1, &placeholder.array);
+		GLState::bindTextureForUpdate(0, GL_TEXTURE_2D_ARRAY, placeholder.array);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	return resident(handle) ? entries[handle].texture : placeholder;
+}
+
+bool TextureCache::resident(int handle)
+{
+	return handle >= 0 && handle < (int)entries.size() && entries[handle].state == RESIDENT;
+}
+
+void TextureCache::update()
+{
+	std::vector<Decoded> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.swap(decoded);
+	}
+	for (size_t i = 0; i < finished.size(); i++) {
+		for (size_t e = 0; e < finished[i].errors.size(); e++)
+			std::cout << finished[i].errors[e] << std::endl;
+		Entry& entry = entries[finished[i].handle];
+		if (entry.references == 0) {
+			entry.state = FREE;
+		}
+		else if (!finished[i].ok) {
+			std::cout << "Unable to load texture " << entry.path << std::endl;
+			entry.state = FAILED;
+		}
+		else {
+			entry.image = std::move(finished[i].image);
+			entry.texture = allocate(entry.image);
+			entry.state = UPLOADING;
+			entry.level = 0;
+			entry.row = 0;
+			uploads.push_back(finished[i].handle);
+		}
+	}
+	if (uploads.empty()) return;
+
+	// Copy as many whole rows (rows of 4x4 blocks when compressed) as fit in the budget into a freshly
+	// orphaned staging buffer, then issue the texture updates from it so the copies happen asynchronously
+	struct Region {
+		TextureLayer texture;
+		GLenum format;
+		int level, y, width, height;
+		size_t offset, size;
+	};
+	std::vector<Region> regions;
+	if (!stagingBuffer) glGenBuffers(1, &stagingBuffer);
+	GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, UPLOAD_BUDGET, NULL, GL_STREAM_DRAW);
+	unsigned char* staging = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, UPLOAD_BUDGET, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	size_t used = 0;
+	while (staging && !uploads.empty()) {
+		Entry& entry = entries[uploads.front()];
+		GLenum format = entry.image.format;
+		int rowHeight = TextureBlockBytes(format) ? 4 : 1;
+		int width = std::max(1, entry.image.width >> entry.level);
+		int height = std::max(1, entry.image.height >> entry.level);
+		int rowCount = (height + rowHeight - 1) / rowHeight;
+		size_t rowBytes = TextureLevelSize(format, width, rowHeight);
+		int rows = std::min(rowCount - entry.row, (int)((UPLOAD_BUDGET - used) / rowBytes));
+		if (rows <= 0) break;
+
+		int y = entry.row * rowHeight;
+		Region region = { entry.texture, format, entry.level, y, width, std::min(rows * rowHeight, height - y), used, rows * rowBytes };
+		memcpy(staging + used, &entry.image.levels[entry.level][entry.row * rowBytes], region.size);
+		regions.push_back(region);
+		used += region.size;
+
+		entry.row += rows;
+		if (entry.row < rowCount) continue;
+		entry.row = 0;
+		if (++entry.level < (int)entry.image.levels.size()) continue;
+		entry.state = RESIDENT;
+		entry.image = TextureData();
+		uploads.pop_front();
+	}
+	if (staging) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	for (size_t i = 0; i < regions.size(); i++) {
+		const Region& r = regions[i];
+		GLState::bindTextureForUpdate(0, GL_TEXTURE_2D_ARRAY, r.texture.array);
+		if (r.format == GL_RGBA8)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, r.level, 0, r.y, r.texture.layer, r.width, r.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)r.offset);
+		else
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, r.level, 0, r.y, r.texture.layer, r.width, r.height, 1, r.format, (GLsizei)r.size, (GLvoid*)r.offset);
+	}
+	// Client-memory uploads elsewhere must not read from the staging buffer
+	GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+size_t TextureCache::pending()
+{
+	size_t count = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+		if (entries[i].state == DECODING || entries[i].state == UPLOADING) count++;
+	return count;
+}
+
+size_t TextureCache::size()
+{
+	return handles.size();
+}
+
+void TextureCache::clear()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+	stopping = false;
+	decoded.clear();
+
+	for (auto it = arrays.begin(); it != arrays.end(); ++it)
+		for (size_t a = 0; a < it->second.size(); a++)
+			glDeleteTextures(1, &it->second[a].texture);
+	arrays.clear();
+	if (placeholder.array) glDeleteTextures(1, &placeholder.array);
+	placeholder.array = 0;
+	if (stagingBuffer) glDeleteBuffers(1, &stagingBuffer);
+	stagingBuffer = 0;
+	entries.clear();
+	handles.clear();
+	uploads.clear();
+	GLState::invalidate();
+}
+
+void TextureCache::work()
+{
+	for (;;) {
+		std::pair<int, std::string> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [] { return stopping || !jobs.empty(); });
+			if (stopping) return;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		Decoded result;
+		result.handle = job.first;
+		result.ok = decode(job.second, result.image, result.errors);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.push_back(std::move(result));
+	}
+}
+
+bool TextureCache::decode(const std::string& path, TextureData& image, std::vector<std::string>& errors)
+{
+	// Offline-compressed versions win over the source image
+	std::string stem = path.substr(0, path.find_last_of('.'));
+	const char* containers[2] = { ".ktx", ".dds" };
+	std::string error;
+	for (int i = 0; i < 2; i++) {
+		if (LoadCompressedTexture(stem + containers[i], image, error)) return true;
+		if (!error.empty()) errors.push_back(error);
+		error.clear();
+	}
+	bool ok = LoadImageTexture(path, image, error);
+	if (!error.empty()) errors.push_back(error);
+	return ok;
+}
+
+TextureLayer TextureCache::allocate(const TextureData& image)
+{
+	int levels = (int)image.levels.size();
+	std::vector<Array>& sized = arrays[std::make_tuple(image.format, levels, image.width, image.height)];
+	GLsizei allocated = 0;
+	for (size_t a = 0; a < sized.size(); a++) {
+		allocated += (GLsizei)sized[a].used.size();
+		for (GLsizei layer = 0; layer < (GLsizei)sized[a].used.size(); layer++) {
+			if (sized[a].used[layer]) continue;
+			sized[a].used[layer] = true;
+			TextureLayer texture = { sized[a].texture, layer };
+			return texture;
+		}
+	}
+
+	// Every array of this size is full. The new one holds as many layers as all the others together,
+	// up to LAYERS_PER_ARRAY, so a size used once costs one layer and growth at most doubles what is held.
+	// Storage for the whole mip chain is allocated up front, since the chain comes precomputed instead of
+	// from glGenerateMipmap.
+	GLsizei layers = allocated == 0 ? 1 : allocated < LAYERS_PER_ARRAY ? allocated : LAYERS_PER_ARRAY;
+	Array array;
+	glGenTextures(1, &array.texture);
+	array.used.assign(layers, false);
+	array.used[0] = true;
+	GLState::bindTextureForUpdate(0, GL_TEXTURE_2D_ARRAY, array.texture);
+	for (int level = 0; level < levels; level++) {
+		int w = std::max(1, image.width >> level);
+		int h = std::max(1, image.height >> level);
+		if (image.format == GL_RGBA8)
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, w, h, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		else
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, image.format, w, h, layers, 0, (GLsizei)(TextureLevelSize(image.format, w, h) * layers), NULL);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	sized.push_back(array);
+	TextureLayer texture = { array.texture, 0 };
+	return texture;
+}
+
+void TextureCache::releaseLayer(const TextureLayer& texture)
+{
+	for (auto it = arrays.begin(); it != arrays.end(); ++it) {
+		std::vector<Array>& sized = it->second;
+		for (size_t a = 0; a < sized.size(); a++) {
+			if (sized[a].texture != texture.array) continue;
+			sized[a].used[texture.layer] = false;
+			if (std::find(sized[a].used.begin(), sized[a].used.end(), true) == sized[a].used.end()) {
+				glDeleteTextures(1, &sized[a].texture);
+				sized.erase(sized.begin() + a);
+				if (sized.empty()) arrays.erase(it);
+				GLState::invalidate();
+			}
+			return;
+		}
+	}
+}
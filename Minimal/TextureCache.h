@@ -0,0 +1,104 @@
+#ifndef _TEXTURE_CACHE_H_
+#define _TEXTURE_CACHE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include "TextureFile.h"
+
+// Where a cached image lives: one layer of a GL_TEXTURE_2D_ARRAY
+struct TextureLayer {
+	GLuint array;
+	GLint layer;
+};
+
+// Images shared by every Model, loaded once per path and reference counted. Images of the same size
+// are packed as layers of the same texture array, so meshes that use different images of that size
+// draw with the same texture binding and only a different layer index.
+// Decoding and mip generation run on worker threads; update() streams the results into their layers
+// through a pixel buffer object, a budgeted number of bytes per frame. Until an image is resident,
+// layer() returns a 1x1 white placeholder.
+// A .ktx or .dds file next to the requested image (same name, made by compress_textures.py) is
+// loaded instead when the GPU supports its format, and stays block-compressed in VRAM.
+class TextureCache
+{
+public:
+	// Most layers in one array. Arrays grow towards this as a size is used more; past it a size gets more arrays.
+	static const GLsizei LAYERS_PER_ARRAY = 8;
+	static const int WORKER_THREADS = 2;
+	// Bytes of pixel data handed to GL per update()
+	static const size_t UPLOAD_BUDGET = 4 << 20;
+
+	// Returns a handle at once and adds a reference; the image is decoded the first time its path is seen
+	static int acquire(const std::string& path);
+	// Drops a reference taken by acquire; the layer is reused once nothing refers to it
+	static void release(int handle);
+	// Layer to sample for handle this frame
+	static TextureLayer layer(int handle);
+	static bool resident(int handle);
+	// Moves finished decodes into layers and streams pixel data; call once per frame
+	static void update();
+	// Images still being decoded or uploaded
+	static size_t pending();
+	static size_t size();
+	// Stops the workers and deletes every array; call while the context that created them is still current
+	static void clear();
+
+private:
+	enum State { FREE, DECODING, UPLOADING, RESIDENT, FAILED };
+
+	struct Entry {
+		std::string path;
+		State state;
+		int references;
+		TextureLayer texture;
+		TextureData image;
+		// Next rows to upload, in blocks for compressed formats
+		int level, row;
+	};
+
+	struct Array {
+		GLuint texture;
+		std::vector<bool> used;
+	};
+
+	struct Decoded {
+		int handle;
+		bool ok;
+		TextureData image;
+		// Workers never print; update() logs these on the GL thread
+		std::vector<std::string> errors;
+	};
+
+	static std::vector<Entry> entries;
+	static std::unordered_map<std::string, int> handles;
+	// Arrays by format, mip level count, layer width and height
+	static std::map<std::tuple<GLenum, int, int, int>, std::vector<Array> > arrays;
+	static TextureLayer placeholder;
+	static GLuint stagingBuffer;
+	static std::deque<int> uploads;
+
+	// Shared with the workers
+	static std::vector<std::thread> workers;
+	static std::mutex mutex;
+	static std::condition_variable wake;
+	static std::deque<std::pair<int, std::string> > jobs;
+	static std::vector<Decoded> decoded;
+	static bool stopping;
+
+	static void work();
+	static bool decode(const std::string& path, TextureData& image, std::vector<std::string>& errors);
+	static TextureLayer allocate(const TextureData& image);
+	static void releaseLayer(const TextureLayer& texture);
+	static void unload(Entry& entry);
+};
+
+#endif
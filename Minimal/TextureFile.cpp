@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <SOIL.h>
+#include "TextureFile.h"
+
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+// Written on the GL thread before any worker starts, read by the workers afterwards
+static bool SupportsS3TC = false;
+static bool SupportsBPTC = false;
+
+// DXGI_FORMAT values used by DDS files with a DX10 header
+static const unsigned int DXGI_BC1_UNORM = 71;
+static const unsigned int DXGI_BC3_UNORM = 77;
+static const unsigned int DXGI_BC7_UNORM = 98;
+
+// SOIL and the stb_image inside it keep their error state in globals
+static std::mutex SoilMutex;
+
+static const unsigned char KTXIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+void DetectCompressedTextureSupport(){
+	SupportsS3TC = GLEW_EXT_texture_compression_s3tc != 0;
+	SupportsBPTC = GLEW_ARB_texture_compression_bptc != 0;
+}
+
+int TextureBlockBytes(GLenum format){
+	switch (format) {
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return 16;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM: return 16;
+	default: return 0;
+	}
+}
+
+size_t TextureLevelSize(GLenum format, int width, int height){
+	int blockBytes = TextureBlockBytes(format);
+	if (!blockBytes) return (size_t)width * height * 4;
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+static bool Supported(GLenum format){
+	if (format == GL_COMPRESSED_RGBA_BPTC_UNORM) return SupportsBPTC;
+	return TextureBlockBytes(format) && SupportsS3TC;
+}
+
+static unsigned int ReadU32(const unsigned char * p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// Fills data.levels from consecutive level images starting at offset; KTX prefixes each with its size
+static bool ReadLevels(const std::vector<unsigned char> & file, size_t offset, int levels, bool sizePrefix, TextureData & data){
+	for (int level = 0; level < levels; level++) {
+		int w = std::max(1, data.width >> level);
+		int h = std::max(1, data.height >> level);
+		size_t size = TextureLevelSize(data.format, w, h);
+		if (sizePrefix) {
+			if (offset + 4 > file.size() || ReadU32(&file[offset]) != size) return false;
+			offset += 4;
+		}
+		if (offset + size > file.size()) return false;
+		data.levels.push_back(std::vector<unsigned char>(file.begin() + offset, file.begin() + offset + size));
+		// KTX pads every level to 4 bytes, which whole blocks always are
+		offset += size;
+	}
+	return true;
+}
+
+static bool ParseDDS(const std::vector<unsigned char> & file, TextureData & data){
+	if (file.size() < 128 || memcmp(&file[0], "DDS ", 4) != 0) return false;
+	data.height = (int)ReadU32(&file[12]);
+	data.width = (int)ReadU32(&file[16]);
+	int levels = std::max(1, (int)ReadU32(&file[28]));
+	const unsigned char * fourCC = &file[84];
+	size_t offset = 128;
+	if (memcmp(fourCC, "DXT1", 4) == 0) data.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	else if (memcmp(fourCC, "DXT5", 4) == 0) data.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	else if (memcmp(fourCC, "DX10", 4) == 0 && file.size() >= 148) {
+		unsigned int dxgi = ReadU32(&file[128]);
+		offset = 148;
+		if (dxgi == DXGI_BC1_UNORM) data.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		else if (dxgi == DXGI_BC3_UNORM) data.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		else if (dxgi == DXGI_BC7_UNORM) data.format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		else return false;
+	}
+	else return false;
+	return ReadLevels(file, offset, levels, false, data);
+}
+
+static bool ParseKTX(const std::vector<unsigned char> & file, TextureData & data){
+	if (file.size() < 64 || memcmp(&file[0], KTXIdentifier, 12) != 0) return false;
+	// Only little-endian files; the header fields then read as written
+	if (ReadU32(&file[12]) != 0x04030201) return false;
+	data.format = ReadU32(&file[28]);
+	data.width = (int)ReadU32(&file[36]);
+	data.height = (int)ReadU32(&file[40]);
+	unsigned int arrayElements = ReadU32(&file[48]);
+	unsigned int faces = ReadU32(&file[52]);
+	int levels = std::max(1, (int)ReadU32(&file[56]));
+	size_t offset = 64 + ReadU32(&file[60]);
+	if (!TextureBlockBytes(data.format) || arrayElements > 1 || faces != 1) return false;
+	return ReadLevels(file, offset, levels, true, data);
+}
+
+bool LoadCompressedTexture(const std::string & path, TextureData & data, std::string & error){
+	std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+	if (!stream.is_open()) return false;
+	std::vector<unsigned char> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+	data.levels.clear();
+	bool ok = ParseKTX(file, data) || ParseDDS(file, data);
+	if (!ok) {
+		error = path + ": not a BC1, BC3 or BC7 DDS/KTX file";
+		return false;
+	}
+	if (!Supported(data.format)) {
+		std::ostringstream message;
+		message << path << ": compressed format 0x" << std::hex << data.format << " not supported by this GPU";
+		error = message.str();
+		return false;
+	}
+	return true;
+}
+
+bool LoadImageTexture(const std::string & path, TextureData & data, std::string & error){
+	int width, height;
+	{
+		std::lock_guard<std::mutex> lock(SoilMutex);
+		unsigned char * pixels = SOIL_load_image(path.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
+		if (!pixels) {
+			error = path + ": " + SOIL_last_result();
+			return false;
+		}
+		data.levels.clear();
+		data.levels.push_back(std::vector<unsigned char>(pixels, pixels + (size_t)width * height * 4));
+		SOIL_free_image_data(pixels);
+	}
+	data.format = GL_RGBA8;
+	data.width = width;
+	data.height = height;
+
+	// 2x2 box filter; an odd row or column is folded into its neighbour by clamping
+	for (int level = 1; (width | height) >> level; level++) {
+		const std::vector<unsigned char> & source = data.levels[level - 1];
+		int sw = std::max(1, width >> (level - 1));
+		int sh = std::max(1, height >> (level - 1));
+		int w = std::max(1, width >> level);
+		int h = std::max(1, height >> level);
+		std::vector<unsigned char> target((size_t)w * h * 4);
+		for (int y = 0; y < h; y++) {
+			int y0 = std::min(y * 2, sh - 1), y1 = std::min(y * 2 + 1, sh - 1);
+			for (int x = 0; x < w; x++) {
+				int x0 = std::min(x * 2, sw - 1), x1 = std::min(x * 2 + 1, sw - 1);
+				for (int c = 0; c < 4; c++) {
+					int sum = source[(y0 * sw + x0) * 4 + c] + source[(y0 * sw + x1) * 4 + c] + source[(y1 * sw + x0) * 4 + c] + source[(y1 * sw + x1) * 4 + c];
+					target[(y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		data.levels.push_back(std::move(target));
+	}
+	return true;
+}
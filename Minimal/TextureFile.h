@@ -0,0 +1,34 @@
+#ifndef _TEXTURE_FILE_H_
+#define _TEXTURE_FILE_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// Pixel data ready to hand to GL: RGBA8 (GL_RGBA8) or BC1/BC3/BC7 blocks (GL_COMPRESSED_*), one entry per mip level
+struct TextureData {
+	GLenum format;
+	int width, height;
+	std::vector<std::vector<unsigned char> > levels;
+};
+
+// Bytes per 4x4 block of a compressed format, 0 for GL_RGBA8
+int TextureBlockBytes(GLenum format);
+
+// Bytes of a width x height image; compressed sizes round up to whole 4x4 blocks
+size_t TextureLevelSize(GLenum format, int width, int height);
+
+// Reads BC1 ("DXT1"), BC3 ("DXT5") or BC7 (DX10 header) DDS files and KTX 1.1 files holding one of those formats,
+// including whatever mip levels they store. Formats the driver cannot sample are rejected so the caller can fall back.
+// The loaders run on worker threads and never print; error receives a line for the caller to log, and stays
+// empty when the file simply does not exist.
+bool LoadCompressedTexture(const std::string & path, TextureData & data, std::string & error);
+
+// Decodes a PNG, JPG, TGA or BMP to RGBA8 and builds the full mip chain with a 2x2 box filter.
+// SOIL keeps global state, so decodes on different threads take turns; the mip chain is built in parallel.
+bool LoadImageTexture(const std::string & path, TextureData & data, std::string & error);
+
+// Checks which compressed formats the current context supports; call on the GL thread before LoadCompressedTexture
+void DetectCompressedTextureSupport();
+
+#endif
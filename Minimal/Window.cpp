@@ -20,11 +20,11 @@ Model * o2;
 GLint Window::currentShader;
 GLint shaderProgram;
 
-// On some systems you need to change this to the absolute path
-#define VERTEX_SHADER_PATH "../shader.vert"
-#define FRAGMENT_SHADER_PATH "../shader.frag"
-#define VERTEX_SHADER2_PATH "../shader2.vert"
-#define FRAGMENT_SHADER2_PATH "../shader2.frag"
+// Shaders are looked up by name among the sources embedded at build time (see shader.h)
+#define VERTEX_SHADER_PATH "shader.vert"
+#define FRAGMENT_SHADER_PATH "shader.frag"
+#define VERTEX_SHADER2_PATH "shader2.vert"
+#define FRAGMENT_SHADER2_PATH "shader2.frag"
 
 // Default camera parameters
 glm::vec3 cam_pos(0.0f, 0.0f, 20.0f);		// e  | Position of camera
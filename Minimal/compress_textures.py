@@ -0,0 +1,197 @@
+"""Converts source images to block-compressed textures that TextureCache loads in their place.
+
+    python compress_textures.py [--format auto|bc1|bc3|bc7] [--ktx] image...
+
+Each image is written next to itself with the same name and a .dds (default) or .ktx extension,
+with the full mip chain. auto picks BC1 for fully opaque images and BC3 otherwise; BC7 gives the
+best quality but needs a GPU with ARB_texture_compression_bptc (TextureCache falls back to the
+source image without it). Needs Pillow to read the source images. The encoders are simple
+bounding-box fits, meant for offline use on the few textures the scene has.
+"""
+import argparse
+import os
+import struct
+import sys
+
+try:
+    from PIL import Image
+except ImportError:
+    sys.exit('compress_textures.py needs Pillow (pip install pillow)')
+
+GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1
+GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3
+GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C
+GL_RGBA = 0x1908
+DXGI_FORMAT_BC7_UNORM = 98
+
+BC7_WEIGHTS = (0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64)
+
+
+def blocks(image):
+    """Yields the 16 RGBA pixels of every 4x4 block, rows of blocks top to bottom, edges clamped."""
+    width, height = image.size
+    pixels = image.load()
+    for by in range(0, height, 4):
+        for bx in range(0, width, 4):
+            yield [pixels[min(bx + x, width - 1), min(by + y, height - 1)] for y in range(4) for x in range(4)]
+
+
+def endpoints(block, channels):
+    """Bounding box of the block's pixels, with each channel's ends oriented along the dominant channel."""
+    lo = [min(p[c] for p in block) for c in range(channels)]
+    hi = [max(p[c] for p in block) for c in range(channels)]
+    main = max(range(channels), key=lambda c: hi[c] - lo[c])
+    mean = [sum(p[c] for p in block) / 16.0 for c in range(channels)]
+    for c in range(channels):
+        if c == main:
+            continue
+        covariance = sum((p[c] - mean[c]) * (p[main] - mean[main]) for p in block)
+        if covariance < 0:
+            lo[c], hi[c] = hi[c], lo[c]
+    return lo, hi
+
+
+def nearest(pixel, palette, channels):
+    return min(range(len(palette)), key=lambda i: sum((pixel[c] - palette[i][c]) ** 2 for c in range(channels)))
+
+
+def pack565(color):
+    return ((color[0] * 31 + 127) // 255) << 11 | ((color[1] * 63 + 127) // 255) << 5 | ((color[2] * 31 + 127) // 255)
+
+
+def unpack565(value):
+    r, g, b = value >> 11, (value >> 5) & 63, value & 31
+    return ((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2))
+
+
+def color_block(block):
+    """The 8-byte BC1 colour block, always in four-colour mode."""
+    lo, hi = endpoints(block, 3)
+    c0, c1 = pack565(hi), pack565(lo)
+    if c0 < c1:
+        c0, c1 = c1, c0
+    if c0 == c1:
+        return struct.pack('<HHI', c0, c1, 0)
+    e0, e1 = unpack565(c0), unpack565(c1)
+    palette = [e0, e1,
+               tuple((2 * a + b + 1) // 3 for a, b in zip(e0, e1)),
+               tuple((a + 2 * b + 1) // 3 for a, b in zip(e0, e1))]
+    bits = 0
+    for i, p in enumerate(block):
+        bits |= nearest(p, palette, 3) << (2 * i)
+    return struct.pack('<HHI', c0, c1, bits)
+
+
+def alpha_block(block):
+    """The 8-byte BC3 alpha block in eight-value mode."""
+    a0 = max(p[3] for p in block)
+    a1 = min(p[3] for p in block)
+    if a0 == a1:
+        return struct.pack('<BB', a0, a1) + bytes(6)
+    palette = [(a0,), (a1,)] + [(((7 - i) * a0 + i * a1 + 3) // 7,) for i in range(1, 7)]
+    bits = 0
+    for i, p in enumerate(block):
+        bits |= nearest((p[3],), palette, 1) << (3 * i)
+    return struct.pack('<BB', a0, a1) + bits.to_bytes(6, 'little')
+
+
+def bc7_block(block):
+    """A BC7 mode 6 block: one RGBA subset, 7-bit endpoints plus a p-bit each, 4-bit indices."""
+    lo, hi = endpoints(block, 4)
+    quantized = []
+    for end in (lo, hi):
+        best = None
+        for p in (0, 1):
+            q = [min(127, max(0, (v - p + 1) // 2)) for v in end]
+            error = sum(((c << 1 | p) - v) ** 2 for c, v in zip(q, end))
+            if best is None or error < best[0]:
+                best = (error, q, p)
+        quantized.append(best[1:])
+    (q0, p0), (q1, p1) = quantized
+    e0 = [c << 1 | p0 for c in q0]
+    e1 = [c << 1 | p1 for c in q1]
+    palette = [tuple(((64 - w) * a + w * b + 32) >> 6 for a, b in zip(e0, e1)) for w in BC7_WEIGHTS]
+    indices = [nearest(p, palette, 4) for p in block]
+    # The anchor (first) index is stored without its top bit, so it must be below 8
+    if indices[0] >= 8:
+        q0, p0, q1, p1 = q1, p1, q0, p0
+        indices = [15 - i for i in indices]
+
+    bits, shift = 1 << 6, 7
+    for c in range(4):
+        bits |= q0[c] << shift
+        bits |= q1[c] << (shift + 7)
+        shift += 14
+    bits |= p0 << shift | p1 << (shift + 1)
+    shift += 2
+    for i, index in enumerate(indices):
+        bits |= index << shift
+        shift += 3 if i == 0 else 4
+    return bits.to_bytes(16, 'little')
+
+
+def encode(image, fmt):
+    if fmt == 'bc1':
+        return b''.join(color_block(b) for b in blocks(image))
+    if fmt == 'bc3':
+        return b''.join(alpha_block(b) + color_block(b) for b in blocks(image))
+    return b''.join(bc7_block(b) for b in blocks(image))
+
+
+def mip_chain(image):
+    """Every level down to 1x1, each dimension halved and floored as TextureCache does."""
+    levels = [image]
+    width, height = image.size
+    while width > 1 or height > 1:
+        width, height = max(1, width // 2), max(1, height // 2)
+        levels.append(levels[-1].resize((width, height), Image.BOX))
+    return levels
+
+
+def write_dds(path, fmt, width, height, levels):
+    fourcc = {'bc1': b'DXT1', 'bc3': b'DXT5', 'bc7': b'DX10'}[fmt]
+    flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000
+    caps = 0x1000 | (0x400008 if len(levels) > 1 else 0)
+    header = struct.pack('<4sIIIIIII44sII4sIIIIIIIIII', b'DDS ', 124, flags, height, width, len(levels[0]), 0, len(levels),
+                         bytes(44), 32, 0x4, fourcc, 0, 0, 0, 0, 0, caps, 0, 0, 0, 0)
+    if fmt == 'bc7':
+        header += struct.pack('<IIIII', DXGI_FORMAT_BC7_UNORM, 3, 0, 1, 0)
+    with open(path, 'wb') as f:
+        f.write(header)
+        for level in levels:
+            f.write(level)
+
+
+def write_ktx(path, fmt, width, height, levels):
+    internal = {'bc1': GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 'bc3': GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 'bc7': GL_COMPRESSED_RGBA_BPTC_UNORM}[fmt]
+    header = b'\xabKTX 11\xbb\r\n\x1a\n' + struct.pack('<13I', 0x04030201, 0, 1, 0, internal, GL_RGBA, width, height, 0, 0, 1, len(levels), 0)
+    with open(path, 'wb') as f:
+        f.write(header)
+        for level in levels:
+            # Whole blocks are always a multiple of 4 bytes, so no mip padding is needed
+            f.write(struct.pack('<I', len(level)))
+            f.write(level)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--format', choices=('auto', 'bc1', 'bc3', 'bc7'), default='auto')
+    parser.add_argument('--ktx', action='store_true', help='write KTX 1.1 instead of DDS')
+    parser.add_argument('images', nargs='+')
+    args = parser.parse_args()
+
+    for source in args.images:
+        image = Image.open(source).convert('RGBA')
+        fmt = args.format
+        if fmt == 'auto':
+            fmt = 'bc1' if image.getextrema()[3][0] == 255 else 'bc3'
+        levels = [encode(level, fmt) for level in mip_chain(image)]
+        target = os.path.splitext(source)[0] + ('.ktx' if args.ktx else '.dds')
+        (write_ktx if args.ktx else write_dds)(target, fmt, image.size[0], image.size[1], levels)
+        raw = sum(l.size[0] * l.size[1] * 4 for l in mip_chain(image))
+        print('%s: %s %dx%d, %d levels, %d KB (RGBA8 %d KB)' % (target, fmt.upper(), image.size[0], image.size[1],
+                                                               len(levels), sum(map(len, levels)) // 1024, raw // 1024))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth pre-pass: shader2.vert positions the geometry, nothing is shaded
+void main()
+{
+}
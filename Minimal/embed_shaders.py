@@ -0,0 +1,76 @@
+"""Embeds every .vert and .frag file in this directory into EmbeddedShaders.h.
+
+#include "file" lines are replaced by the file they name (relative to the including file),
+followed by a #line directive so compiler messages keep pointing at the right line.
+Runs as the pre-build step of Minimal.vcxproj; the header is only rewritten when it changes.
+"""
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+OUTPUT = os.path.join(HERE, 'EmbeddedShaders.h')
+INCLUDE = re.compile(r'^\s*#\s*include\s+"([^"]+)"\s*$')
+# MSVC limits a single string literal to 16 KB, so long sources are split into adjacent literals
+CHUNK = 8000
+DELIMITER = 'glsl'
+
+
+def resolve(path, stack=()):
+    """Returns the lines of path with its includes spliced in."""
+    if path in stack:
+        sys.exit('%s: recursive #include' % path)
+    with open(path) as f:
+        lines = f.read().splitlines()
+    out = []
+    for number, line in enumerate(lines, 1):
+        match = INCLUDE.match(line)
+        if match:
+            out.append('#line 1')
+            out.extend(resolve(os.path.join(os.path.dirname(path), match.group(1)), stack + (path,)))
+            out.append('#line %d' % (number + 1))
+        else:
+            out.append(line)
+    return out
+
+
+def literal(source):
+    if ')%s"' % DELIMITER in source:
+        sys.exit('shader source contains the raw string delimiter')
+    chunks = [source[i:i + CHUNK] for i in range(0, len(source), CHUNK)] or ['']
+    return '\n'.join('R"%s(%s)%s"' % (DELIMITER, chunk, DELIMITER) for chunk in chunks)
+
+
+def main():
+    names = sorted(n for n in os.listdir(HERE) if n.endswith(('.vert', '.frag')))
+    entries = []
+    for name in names:
+        entries.append('\t{ "%s",\n%s },' % (name, literal('\n'.join(resolve(os.path.join(HERE, name))) + '\n')))
+    header = '\n'.join([
+        '// Generated by embed_shaders.py from the shaders in this directory. Do not edit.',
+        '#ifndef _EMBEDDED_SHADERS_H_',
+        '#define _EMBEDDED_SHADERS_H_',
+        '',
+        'struct EmbeddedShader {',
+        '\tconst char * name;',
+        '\tconst char * source;',
+        '};',
+        '',
+        'static constexpr EmbeddedShader embeddedShaders[] = {',
+    ] + entries + [
+        '};',
+        '',
+        '#endif',
+        '',
+    ])
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            if f.read() == header:
+                return
+    with open(OUTPUT, 'w') as f:
+        f.write(header)
+    print('embed_shaders: wrote %d shaders to %s' % (len(names), OUTPUT))
+
+
+if __name__ == '__main__':
+    main()
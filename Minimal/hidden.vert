@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec2 tangent; // direction as x/-z, y/-z in eye space
+
+uniform mat4 projection;
+
+void main()
+{
+    gl_Position = projection * vec4(tangent, -1.0f, 1.0f);
+    // On the near plane, so every scene fragment behind it fails the depth test
+    gl_Position.z = -gl_Position.w;
+}
@@ -0,0 +1,45 @@
+#version 330 core
+
+// Hybrid mono composite: reprojects the far-field image into this eye, using the mono depth to account
+// for the eye's offset from the mono camera
+in vec2 ViewportPos;
+
+uniform sampler2D monoColor;
+uniform sampler2D monoDepth;
+uniform mat4 eyeToMono;
+uniform vec4 eyeTangents;  // left, bottom, right, top of the viewport as view-angle tangents
+uniform vec4 monoTangents; // the same for the mono camera
+uniform vec2 monoClip;     // near (the split distance) and far plane of the mono camera
+
+out vec4 color;
+
+vec2 monoCoord(vec3 position)
+{
+    return (position.xy / -position.z - monoTangents.xy) / (monoTangents.zw - monoTangents.xy);
+}
+
+// Distance along the mono camera's view axis of the surface stored at uv
+float monoDistance(vec2 uv)
+{
+    float ndc = texture(monoDepth, uv).r * 2.0f - 1.0f;
+    return 2.0f * monoClip.x * monoClip.y / (monoClip.y + monoClip.x - ndc * (monoClip.y - monoClip.x));
+}
+
+void main()
+{
+    vec3 origin = eyeToMono[3].xyz;
+    vec3 direction = mat3(eyeToMono) * vec3(mix(eyeTangents.xy, eyeTangents.zw, ViewportPos), -1.0f);
+    // The direction alone is exact at infinity. Each step moves to where this eye's ray meets the depth
+    // found at the previous guess; the far field changes depth slowly, so two steps land within a pixel.
+    vec2 uv = monoCoord(direction);
+    for (int i = 0; i < 2; i++) {
+        if (texture(monoDepth, uv).r >= 1.0f)
+            break;
+        float distance = monoDistance(uv);
+        uv = monoCoord(origin + direction * ((distance + origin.z) / -direction.z));
+    }
+    // Nothing beyond the split distance here; keep the clear colour
+    if (texture(monoDepth, uv).r >= 1.0f)
+        discard;
+    color = texture(monoColor, uv);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+
+// Full-viewport quad on the far plane, so the depth test keeps it behind everything the near pass drew
+out vec2 ViewportPos;
+
+void main()
+{
+    ViewportPos = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = vec4(ViewportPos * 2.0f - 1.0f, 1.0f, 1.0f);
+}
@@ -0,0 +1,59 @@
+#version 330 core
+out vec4 color;
+
+// Variants are compiled by ShaderCache with CLUSTERED, OVERDRAW or NUM_POINT_LIGHTS defined
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 4
+#endif
+
+#include "lighting.glsl"
+
+in vec3 QuadPos;
+flat in vec4 Sphere;
+flat in vec3 Ambient;
+flat in vec3 Diffuse;
+flat in vec4 Specular;
+uniform mat4 projection;
+uniform vec3 viewPos;
+#if !defined(CLUSTERED) && !defined(OVERDRAW)
+uniform PointLight pointLight[NUM_POINT_LIGHTS];
+#endif
+
+Material material;
+
+void main()
+{
+    // Intersect the eye ray through this fragment with the sphere; the eye is at the origin
+    vec3 rayDir = normalize(QuadPos);
+    float b = dot(rayDir, Sphere.xyz);
+    float c = dot(Sphere.xyz, Sphere.xyz) - Sphere.w * Sphere.w;
+    float disc = b * b - c;
+    if (disc < 0.0f)
+        discard;
+    vec3 FragPos = rayDir * (b - sqrt(disc));
+    vec3 norm = (FragPos - Sphere.xyz) / Sphere.w;
+
+    vec4 clipPos = projection * vec4(FragPos, 1.0f);
+    gl_FragDepth = (clipPos.z / clipPos.w) * 0.5f + 0.5f;
+
+#ifdef OVERDRAW
+    // The ray test above still runs, so only the sphere's own fragments count, in overdraw.frag's colour
+    color = vec4(0.1f, 0.05f, 0.0f, 1.0f);
+#else
+    material.ambient = Ambient;
+    material.diffuse = Diffuse;
+    material.specular = Specular.rgb;
+    material.shininess = Specular.a;
+
+    vec3 viewDir = normalize(viewPos - FragPos);
+#ifdef CLUSTERED
+    vec3 result = CalcClusteredLights(material, material.diffuse, norm, FragPos, viewDir);
+#else
+    vec3 result = vec3(0.0f, 0.0f, 0.0f);
+    for(int i=0; i<NUM_POINT_LIGHTS; i++){
+        result = result + CalcPointLight(pointLight[i], material, material.diffuse, norm, FragPos, viewDir);
+    }
+#endif
+    color = vec4(result, 1.0);
+#endif
+}
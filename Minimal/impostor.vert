@@ -0,0 +1,37 @@
+#version 330 core
+layout (location = 0) in vec2 corner;
+layout (location = 1) in vec4 sphere;   // world-space centre and radius
+layout (location = 2) in vec3 ambient;
+layout (location = 3) in vec3 diffuse;
+layout (location = 4) in vec4 specular; // rgb specular, a shininess
+
+uniform mat4 model;
+uniform mat4 projection;
+
+out vec3 QuadPos;
+flat out vec4 Sphere;
+flat out vec3 Ambient;
+flat out vec3 Diffuse;
+flat out vec4 Specular;
+
+void main()
+{
+    // Camera-facing quad through the sphere centre, just large enough to cover its silhouette cone
+    vec3 center = vec3(model * vec4(sphere.xyz, 1.0f));
+    float radius = sphere.w;
+    float dist = length(center);
+    vec3 forward = center / dist;
+    vec3 up = abs(forward.y) > 0.99f ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f);
+    // right = forward x up keeps (right, up, -forward) right-handed, so the quad winds counter-clockwise
+    // on screen like the meshes around it rather than mirrored
+    vec3 right = normalize(cross(forward, up));
+    up = cross(right, forward);
+    float halfSize = radius * dist / sqrt(max(dist * dist - radius * radius, 1e-6f));
+
+    QuadPos = center + (right * corner.x + up * corner.y) * halfSize;
+    Sphere = vec4(center, radius);
+    Ambient = ambient;
+    Diffuse = diffuse;
+    Specular = specular;
+    gl_Position = projection * vec4(QuadPos, 1.0f);
+}
@@ -0,0 +1,90 @@
+// Material, point light and the shared point-light model, included by shader2.frag and impostor.frag.
+// Every light position is in view space, the same space as fragPos.
+
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+struct PointLight {
+    vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// albedo stands in for material.diffuse, so textured variants can modulate it
+vec3 CalcPointLight(PointLight light, Material material, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    // Ambient
+    vec3 ambient = light.ambient * material.ambient;
+
+    // Diffuse shading
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * albedo;
+
+    // Specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    vec3 specular = light.specular * spec * material.specular;
+
+    // Attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    // Combine results
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+#ifdef CLUSTERED
+// Filled by ClusteredLights: four texels per light (view space), (offset, count) per froxel, light indices
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterData;
+uniform usamplerBuffer lightIndices;
+uniform vec4 viewportRect;  // x, y, width, height of this eye's viewport
+uniform ivec3 clusterGrid;
+uniform vec2 clusterDepth;  // near plane, log(far / near)
+
+PointLight FetchLight(int index)
+{
+    vec4 t0 = texelFetch(lightData, index * 4);
+    vec4 t1 = texelFetch(lightData, index * 4 + 1);
+    vec4 t2 = texelFetch(lightData, index * 4 + 2);
+    vec4 t3 = texelFetch(lightData, index * 4 + 3);
+    PointLight light;
+    light.position = t0.xyz;
+    light.constant = t0.w;
+    light.ambient = t1.rgb;
+    light.linear = t1.w;
+    light.diffuse = t2.rgb;
+    light.quadratic = t2.w;
+    light.specular = t3.rgb;
+    return light;
+}
+
+// Sums the lights binned into the froxel that holds this fragment
+vec3 CalcClusteredLights(Material material, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    ivec2 tile = ivec2((gl_FragCoord.xy - viewportRect.xy) / viewportRect.zw * vec2(clusterGrid.xy));
+    int slice = int(log(-fragPos.z / clusterDepth.x) / clusterDepth.y * float(clusterGrid.z));
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), clusterGrid - 1);
+    uvec2 range = texelFetch(clusterData, (cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x).xy;
+    vec3 result = vec3(0.0f, 0.0f, 0.0f);
+    for (uint i = 0u; i < range.y; i++) {
+        int index = int(texelFetch(lightIndices, int(range.x + i)).r);
+        result = result + CalcPointLight(FetchLight(index), material, albedo, normal, fragPos, viewDir);
+    }
+    return result;
+}
+#endif
@@ -204,7 +204,9 @@ public:
 		while (!glfwWindowShouldClose(window)) {
 			++frame;
 			glfwPollEvents();
-			update();
+			// The app may have nothing to show this frame, or want its simulation held
+			if (!beginFrame()) continue;
+			if (simulating()) update();
 			draw();
 			finishFrame();
 		}
@@ -283,6 +285,11 @@ protected:
 
 	virtual void update() {}
 
+	// Called every loop iteration before update; false skips the frame's update and draw entirely
+	virtual bool beginFrame() { return true; }
+
+	virtual bool simulating() { return true; }
+
 	virtual void onMouseButton(int button, int action, int mods) {}
 
 protected:
@@ -314,6 +321,15 @@ private:
 
 #include <OVR_CAPI.h>
 #include <OVR_CAPI_GL.h>
+#include "GLState.h"
+#include "ResolutionScaler.h"
+#include "MultiResolution.h"
+#include "HiddenAreaMask.h"
+#include "HybridMono.h"
+#include "HudLayer.h"
+#include "MirrorCapture.h"
+#include "FramePacer.h"
+#include "ShaderCache.h"
 
 namespace ovr {
 
@@ -438,11 +454,44 @@ private:
 	uvec2 _renderTargetSize;
 	uvec2 _mirrorSize;
 
+	// Full-resolution viewport size of each eye; the layer viewports are these times the resolution scale
+	ovrSizei _eyeSizes[2];
+	ResolutionScaler _resolution;
+	MultiResolution _multiRes;
+	HiddenAreaMask _hiddenArea;
+	HybridMono _hybridMono;
+	HudLayer _hud;
+	MirrorCapture _capture;
+	// Mirror window refreshes (and captured frames) per second, independent of the HMD frame rate
+	float _mirrorRate{ 30.0f };
+	double _nextMirror{ 0.0 };
+	bool _mirrorShown{ false };
+	FramePacer _pacer;
+	// Periodic counter reports (S key), off by default so the log stays readable
+	bool _reportStats{ false };
+	// Startup timing: time to the first submitted frame, then the frame times of the first second
+	double _startTime{ 0.0 };
+	double _firstSubmit{ 0.0 };
+	double _lastSubmit{ 0.0 };
+	int _startupFrames{ 0 };
+	int _startupHitches{ 0 };
+	double _startupWorst{ 0.0 };
+	bool _startupReported{ false };
+	// Refreshed at the start of every frame
+	ovrSessionStatus _sessionStatus;
+	// Frame rate line of the HUD, rebuilt once a second
+	std::string _hudStats;
+	int _statsFrames{ 0 };
+	double _statsStart{ 0.0 };
+
 public:
 
 	RiftApp() {
 		using namespace ovr;
+		_startTime = ovr_GetTimeInSeconds();
 		_viewScaleDesc.HmdSpaceToWorldScaleInMeters = 1.0f;
+		memset(&_sessionStatus, 0, sizeof(_sessionStatus));
+		_sessionStatus.IsVisible = _sessionStatus.HmdMounted = ovrTrue;
 
 		memset(&_sceneLayer, 0, sizeof(ovrLayerEyeFov));
 		_sceneLayer.Header.Type = ovrLayerType_EyeFov;
@@ -457,6 +506,7 @@ public:
 
 			ovrFovPort & fov = _sceneLayer.Fov[eye] = _eyeRenderDescs[eye].Fov;
 			auto eyeSize = ovr_GetFovTextureSize(_session, eye, fov, 1.0f);
+			_eyeSizes[eye] = eyeSize;
 			_sceneLayer.Viewport[eye].Size = eyeSize;
 			_sceneLayer.Viewport[eye].Pos = { (int)_renderTargetSize.x, 0 };
 
@@ -466,6 +516,15 @@ public:
 		// Make the on screen window 1/4 the resolution of the render target
 		_mirrorSize = _renderTargetSize;
 		_mirrorSize /= 4;
+
+		// Leave part of the frame to the compositor
+		_resolution.setBudget(0.9f * 1000.0f / _hmdDesc.DisplayRefreshRate);
+		_pacer.setRefreshRate(_hmdDesc.DisplayRefreshRate);
+	}
+
+	// Call before run(); rates at or above the HMD's refresh the mirror every frame
+	void setMirrorRate(float hz) {
+		_mirrorRate = std::max(1.0f, hz);
 	}
 
 protected:
@@ -502,13 +561,13 @@ protected:
 		for (int i = 0; i < length; ++i) {
 			GLuint chainTexId;
 			ovr_GetTextureSwapChainBufferGL(_session, _eyeTexture, i, &chainTexId);
-			glBindTexture(GL_TEXTURE_2D, chainTexId);
+			GLState::bindTextureForUpdate(0, GL_TEXTURE_2D, chainTexId);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::bindTexture(0, GL_TEXTURE_2D, 0);
 
 		// Set up the framebuffer object
 		glGenFramebuffers(1, &_fbo);
@@ -519,6 +578,17 @@ protected:
 		glBindRenderbuffer(GL_RENDERBUFFER, 0);
 		glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		_multiRes.init(_renderTargetSize, _depthBuffer);
+		_hiddenArea.init(_hmdDesc.Type, _sceneLayer.Fov);
+		float hiddenPixels = _hiddenArea.coverage(0) * _eyeSizes[0].w * _eyeSizes[0].h + _hiddenArea.coverage(1) * _eyeSizes[1].w * _eyeSizes[1].h;
+		std::cout << "Hidden area mask: " << _hiddenArea.coverage(0) * 100.0f << "% / " << _hiddenArea.coverage(1) * 100.0f
+			<< "% of eye pixels (left / right), " << (int)hiddenPixels << " pixels per frame not shaded" << std::endl;
+		_hybridMono.init(_sceneLayer.Fov, _eyeSizes);
+		_hud.init(_session);
+		// The eye-level passes' programs compile alongside the scene's, not on the frame that first needs them
+		ShaderCache::request("hidden.vert", "depth.frag");
+		ShaderCache::request("multires.vert", "multires.frag");
+		ShaderCache::request("hybrid.vert", "hybrid.frag");
 
 		ovrMirrorTextureDesc mirrorDesc;
 		memset(&mirrorDesc, 0, sizeof(mirrorDesc));
@@ -529,6 +599,12 @@ protected:
 			FAIL("Could not create mirror texture");
 		}
 		glGenFramebuffers(1, &_mirrorFbo);
+		std::cout << "Mirror window and capture at " << _mirrorRate << " fps" << std::endl;
+	}
+
+	// Runs before ~RiftManagerApp destroys the session
+	void shutdownGl() override {
+		_hud.destroy();
 	}
 
 	void onKey(int key, int scancode, int action, int mods) override {
@@ -536,14 +612,91 @@ protected:
 		case GLFW_KEY_R:
 			ovr_RecenterTrackingOrigin(_session);
 			return;
+		case GLFW_KEY_D:
+			_resolution.enabled = !_resolution.enabled;
+			std::cout << "Dynamic resolution " << (_resolution.enabled ? "on" : "off") << std::endl;
+			return;
+		case GLFW_KEY_M:
+			_multiRes.enabled = !_multiRes.enabled;
+			std::cout << "Multi-resolution " << (_multiRes.enabled ? "on" : "off") << std::endl;
+			return;
+		case GLFW_KEY_H:
+			_hiddenArea.enabled = !_hiddenArea.enabled;
+			std::cout << "Hidden area mask " << (_hiddenArea.enabled ? "on" : "off") << std::endl;
+			return;
+		case GLFW_KEY_C:
+			if (_capture.active()) _capture.stop();
+			else _capture.start(_mirrorSize.x, _mirrorSize.y);
+			return;
+		case GLFW_KEY_S:
+			_reportStats = _pacer.reporting = !_reportStats;
+			std::cout << "Stats reports " << (_reportStats ? "on" : "off") << std::endl;
+			return;
+		case GLFW_KEY_T:
+			_pacer.enabled = !_pacer.enabled;
+			std::cout << "Frame pacing " << (_pacer.enabled ? "on" : "off") << std::endl;
+			return;
+		case GLFW_KEY_U:
+			_hud.enabled = !_hud.enabled;
+			return;
+		case GLFW_KEY_F:
+			_hybridMono.enabled = !_hybridMono.enabled;
+			std::cout << "Hybrid mono " << (_hybridMono.enabled ? "on" : "off") << ", split at " << _hybridMono.splitDistance << " m" << std::endl;
+			return;
 		}
 
 		GlfwApp::onKey(key, scancode, action, mods);
 	}
 
+	bool beginFrame() override {
+		ovrSessionStatus status;
+		if (!OVR_SUCCESS(ovr_GetSessionStatus(_session, &status))) {
+			std::cout << "Lost the connection to the Oculus service, quitting" << std::endl;
+			glfwSetWindowShouldClose(window, 1);
+			return false;
+		}
+		if (status.ShouldQuit || status.DisplayLost) {
+			std::cout << (status.ShouldQuit ? "The runtime asked us to quit" : "HMD display lost, quitting") << std::endl;
+			glfwSetWindowShouldClose(window, 1);
+			return false;
+		}
+		// Also clears the flag
+		if (status.ShouldRecenter) ovr_RecenterTrackingOrigin(_session);
+		if (status.IsVisible != _sessionStatus.IsVisible)
+			std::cout << (status.IsVisible ? "Visible in the HMD again, rendering" : "Not visible in the HMD, rendering stopped") << std::endl;
+		if (status.HmdMounted != _sessionStatus.HmdMounted)
+			std::cout << (status.HmdMounted ? "HMD mounted, simulation resumed" : "HMD taken off, simulation paused") << std::endl;
+		bool wasActive = _sessionStatus.IsVisible && _sessionStatus.HmdMounted;
+		bool active = status.IsVisible && status.HmdMounted;
+		_sessionStatus = status;
+		if (active != wasActive) onPause(!active);
+
+		// Another app has focus or the HMD is asleep: nothing we draw would be seen, so draw nothing and idle
+		if (!status.IsVisible) {
+			_pacer.idle();
+			Sleep(100);
+			return false;
+		}
+		_pacer.beginFrame(_session, frame, _resolution.gpuMilliseconds());
+		return true;
+	}
+
+	bool simulating() override {
+		return _sessionStatus.HmdMounted != ovrFalse;
+	}
+
+	bool reportingStats() const {
+		return _reportStats;
+	}
+
+	// Called when the simulation stops (HMD taken off or app not visible) and when it starts again
+	virtual void onPause(bool paused) {}
+
 	void draw() final override {
 		ovrPosef eyePoses[2];
 		ovr_GetEyePoses(_session, frame, true, _viewScaleDesc.HmdToEyeOffset, eyePoses, &_sceneLayer.SensorSampleTime);
+		// The same display time ovr_GetEyePoses predicts for, as late as anything can still be sampled
+		latchPoses(ovr_GetPredictedDisplayTime(_session, frame));
 
 		int curIndex;
 		ovr_GetTextureSwapChainCurrentIndex(_session, _eyeTexture, &curIndex);
@@ -551,28 +704,176 @@ protected:
 		ovr_GetTextureSwapChainBufferGL(_session, _eyeTexture, curIndex, &curTexId);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, curTexId, 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		ovr::for_each_eye([&](ovrEyeType eye) {
-			const auto& vp = _sceneLayer.Viewport[eye];
-			glViewport(vp.Pos.x, vp.Pos.y, vp.Size.w, vp.Size.h);
-			_sceneLayer.RenderPose[eye] = eyePoses[eye];
-			renderScene(_eyeProjections[eye], ovr::toGlm(eyePoses[eye]));
-		});
+		_resolution.beginFrame();
+
+		renderEyes(eyePoses, _hybridMono.enabled, _multiRes.enabled);
+		_resolution.endFrame();
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 		ovr_CommitTextureSwapChain(_session, _eyeTexture);
-		ovrLayerHeader* headerList = &_sceneLayer.Header;
-		ovr_SubmitFrame(_session, frame, &_viewScaleDesc, &headerList, 1);
 
+		updateHudStats();
+		_hud.setText(hudText() + _hudStats);
+		ovrLayerHeader* headerList[2] = { &_sceneLayer.Header, _hud.header() };
+		_pacer.endFrame();
+		ovr_SubmitFrame(_session, frame, &_viewScaleDesc, headerList, headerList[1] ? 2 : 1);
+		recordStartup();
+
+		// The window is only a preview, so it is blitted and swapped at the mirror rate rather than every HMD frame
+		double now = ovr_GetTimeInSeconds();
+		_mirrorShown = now >= _nextMirror;
+		if (!_mirrorShown) return;
+		// Catch up without bursting after a hitch
+		_nextMirror = std::max(_nextMirror + 1.0 / _mirrorRate, now);
 		GLuint mirrorTextureId;
 		ovr_GetMirrorTextureBufferGL(_session, _mirrorTexture, &mirrorTextureId);
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, _mirrorFbo);
 		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mirrorTextureId, 0);
 		glBlitFramebuffer(0, 0, _mirrorSize.x, _mirrorSize.y, 0, _mirrorSize.y, _mirrorSize.x, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		_capture.frame();
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 	}
 
-	virtual void renderScene(const glm::mat4 & projection, const glm::mat4 & headPose) = 0;
+	void finishFrame() override {
+		if (_mirrorShown) GlfwApp::finishFrame();
+	}
+
+	// Draws one frame of the eye-level passes for each combination of hybrid mono and multi-resolution, with
+	// the hidden-area mask on, into a throwaway texture in the swap chain's sRGB format. The eyes are posed
+	// as for a head at the origin, so every view index meets its programs and state here rather than in
+	// the first frames. Returns the number of frames drawn.
+	int warmUpEyes() {
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLState::bindTextureForUpdate(0, GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, _renderTargetSize.x, _renderTargetSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+		ovrPosef eyePoses[2];
+		ovr::for_each_eye([&](ovrEyeType eye) {
+			eyePoses[eye].Orientation = { 0.0f, 0.0f, 0.0f, 1.0f };
+			eyePoses[eye].Position = _viewScaleDesc.HmdToEyeOffset[eye];
+		});
+		bool hiddenArea = _hiddenArea.enabled;
+		_hiddenArea.enabled = true;
+		int frames = 0;
+		for (int combination = 0; combination < 4; combination++) {
+			renderEyes(eyePoses, (combination & 1) != 0, (combination & 2) != 0);
+			frames++;
+		}
+		_hiddenArea.enabled = hiddenArea;
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glDeleteTextures(1, &texture);
+		GLState::invalidate();
+		return frames;
+	}
+
+	// view is the eye index, or ovrEye_Count for the hybrid mono camera, so per-view state never mixes the two
+	virtual void renderScene(const glm::mat4 & projection, const glm::mat4 & headPose, int view) = 0;
+
+	// Samples anything else tracked (controllers) for the frame about to be drawn
+	virtual void latchPoses(double displayTime) {}
+
+	// Application lines for the HUD, each ending in '\n'; the frame rate line is added after them
+	virtual std::string hudText() { return ""; }
+
+private:
+	// Draws both eyes into _fbo's colour attachment, with the scene past the split drawn once by hybrid mono
+	// and the eyes rendered through the multi-resolution regions when those are on
+	void renderEyes(const ovrPosef eyePoses[2], bool hybrid, bool multiRes) {
+		// Hybrid mono draws everything past the split once, before the eyes, which then stop at the split
+		float monoFar = 1000.0f;
+		float farPlane = hybrid ? _hybridMono.splitDistance : 1000.0f;
+		glm::mat4 monoPose;
+		if (hybrid) {
+			monoPose = HybridMono::centerPose(ovr::toGlm(eyePoses[ovrEye_Left]), ovr::toGlm(eyePoses[ovrEye_Right]));
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _hybridMono.framebuffer());
+			glViewport(0, 0, _hybridMono.size().x, _hybridMono.size().y);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderScene(_hybridMono.projection(monoFar), monoPose, ovrEye_Count);
+		}
+
+		// Multi-resolution renders the eyes into its packed target first and resolves them into the swap chain
+		MultiResRegion regions[2][MultiResolution::REGIONS];
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, multiRes ? _multiRes.framebuffer() : _fbo);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		ovr::for_each_eye([&](ovrEyeType eye) {
+			// Render into the lower-left part of the eye's area; the layer tells the compositor how much of it to use
+			auto& vp = _sceneLayer.Viewport[eye];
+			vp.Size.w = std::max(1, (int)(_eyeSizes[eye].w * _resolution.scale + 0.5f));
+			vp.Size.h = std::max(1, (int)(_eyeSizes[eye].h * _resolution.scale + 0.5f));
+			_sceneLayer.RenderPose[eye] = eyePoses[eye];
+			glm::mat4 eyePose = ovr::toGlm(eyePoses[eye]);
+			if (!multiRes) {
+				const ovrFovPort& fov = _sceneLayer.Fov[eye];
+				glm::mat4 projection = hybrid ?
+					ovr::toGlm(ovrMatrix4f_Projection(fov, 0.01f, farPlane, ovrProjection_ClipRangeOpenGL)) : _eyeProjections[eye];
+				glViewport(vp.Pos.x, vp.Pos.y, vp.Size.w, vp.Size.h);
+				_hiddenArea.draw(eye, projection);
+				renderScene(projection, eyePose, eye);
+				if (hybrid) _hybridMono.composite(eyePose, monoPose, monoFar, glm::vec4(-fov.LeftTan, -fov.DownTan, fov.RightTan, fov.UpTan));
+				return;
+			}
+			MultiResolution::layout(_sceneLayer.Fov[eye], vp, regions[eye]);
+			for (int i = 0; i < MultiResolution::REGIONS; i++) {
+				const MultiResRegion& region = regions[eye][i];
+				glViewport(region.source.Pos.x, region.source.Pos.y, region.source.Size.w, region.source.Size.h);
+				glm::mat4 projection = MultiResolution::projection(region, 0.01f, farPlane);
+				_hiddenArea.draw(eye, projection);
+				renderScene(projection, eyePose, eye);
+				if (hybrid) _hybridMono.composite(eyePose, monoPose, monoFar, glm::vec4(region.left, region.bottom, region.right, region.top));
+			}
+		});
+		if (multiRes) {
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
+			ovr::for_each_eye([&](ovrEyeType eye) {
+				_multiRes.resolve(regions[eye]);
+			});
+		}
+	}
+
+	void recordStartup() {
+		if (_startupReported) return;
+		double now = ovr_GetTimeInSeconds();
+		if (_firstSubmit == 0.0) {
+			_firstSubmit = _lastSubmit = now;
+			std::cout << "First frame submitted " << (now - _startTime) * 1000.0 << " ms after startup" << std::endl;
+			return;
+		}
+		double milliseconds = (now - _lastSubmit) * 1000.0;
+		_lastSubmit = now;
+		if (now - _firstSubmit <= 1.0) {
+			_startupFrames++;
+			_startupWorst = std::max(_startupWorst, milliseconds);
+			if (milliseconds > 1.5 * 1000.0 / _hmdDesc.DisplayRefreshRate) _startupHitches++;
+			return;
+		}
+		std::cout << "First second: " << _startupFrames << " frames, worst " << _startupWorst << " ms, "
+			<< _startupHitches << " longer than 1.5 refresh intervals" << std::endl;
+		_startupReported = true;
+	}
+
+	void updateHudStats() {
+		++_statsFrames;
+		double now = glfwGetTime();
+		if (_hudStats.empty()) {
+			_hudStats = "-- FPS";
+			_statsFrames = 0;
+			_statsStart = now;
+			return;
+		}
+		if (now - _statsStart < 1.0) return;
+		char line[64];
+		snprintf(line, sizeof(line), "%d FPS  GPU %.1f MS", (int)(_statsFrames / (now - _statsStart) + 0.5), _resolution.gpuMilliseconds());
+		_hudStats = line;
+		_statsFrames = 0;
+		_statsStart = now;
+	}
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -588,8 +889,14 @@ protected:
 #include "Group.h"
 #include "MatrixTransform.h"
 #include "Line.h"
+#include "MoleculeImpostor.h"
+#include "ClusteredLights.h"
+#include "ShaderCache.h"
+#include "Haptics.h"
+#include "InputSampler.h"
 struct SimScene {
 	bool isPlaying = true;
+	int captures = 0;
 	bool l_pressed;
 	bool r_pressed;
 	Line * l_line;
@@ -602,28 +909,81 @@ struct SimScene {
 	Group * o2Group;
 	Model * co2;
 	Model * o2;
-	GLint shaderProgram;
+	MoleculeImpostor * co2Impostor;
+	MoleculeImpostor * o2Impostor;
+	ClusteredLights * clusteredLights;
+	std::vector<PointLight> sceneLights;
+	// pointLight uniform names, seven per scene light; see setupLights
+	std::vector<std::string> lightUniforms;
+	// One query per view: the two eyes and the hybrid mono camera
+	GLuint overdrawQueries[3] = { 0, 0, 0 };
+	bool overdrawQueryPending[3] = { false, false, false };
+	bool overdrawQueryActive = false;
+	float overdrawRatio[3] = { 0.0f, 0.0f, 0.0f };
+	unsigned int overdrawReports = 0;
 	time_t last_co2_time;
 	std::default_random_engine generator;
 
-#define VERTEX_SHADER2_PATH "C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/shader2.vert"
-#define FRAGMENT_SHADER2_PATH "C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/shader2.frag"
+// Shader names as embedded by embed_shaders.py
+#define VERTEX_SHADER2 "shader2.vert"
+#define FRAGMENT_SHADER2 "shader2.frag"
+#define IMPOSTOR_VERTEX_SHADER "impostor.vert"
+#define IMPOSTOR_FRAGMENT_SHADER "impostor.frag"
+#define DEPTH_FRAGMENT_SHADER "depth.frag"
+#define OVERDRAW_FRAGMENT_SHADER "overdraw.frag"
 
 public:
+	// Draw molecule atoms as ray-cast sphere impostors instead of tessellated meshes
+	bool useImpostors = true;
+	// Depth-only pre-pass before shading, so each visible pixel runs the lighting once
+	bool depthPrepass = true;
+	// Shade with a flat additive colour and count shaded fragments per pixel
+	bool overdrawMode = false;
+	// Shade meshes and impostor atoms with the CLUSTERED variants, which only loop over the lights binned to each froxel
+	bool clusteredLighting = true;
+	// Every O2 molecule carries a small point light (clustered lighting only; it lights meshes and atoms alike)
+	bool glowingO2 = true;
 	bool leftHandTriggerPressed;
 	bool rightHandTriggerPressed;
+	// Controller poses latched just before the eyes are drawn, for the frame's predicted display time.
+	// Both eyes' lasers use them, and so do the next update's hit tests, which then match what was seen.
 	glm::mat4 left_transf;
 	glm::mat4 right_transf;
 
 	static glm::mat4 P; // P for projection
 	static glm::mat4 V; // V for view
 
-	SimScene() {
-		shaderProgram = LoadShaders(VERTEX_SHADER2_PATH, FRAGMENT_SHADER2_PATH);
+	// meshStats logs the vertex cache efficiency of every asset before loading; it imports each one twice more
+	SimScene(bool meshStats = false) {
+		const glm::vec3 lightPositions[4] = {
+			glm::vec3(10.0f, 10.0f, 5.0f), glm::vec3(10.0f, 10.0f, -20.0f),
+			glm::vec3(-10.0f, 10.0f, 5.0f), glm::vec3(-10.0f, 10.0f, -20.0f)
+		};
+		for (int i = 0; i < 4; i++) {
+			PointLight light = { lightPositions[i], 1.0f, 0.09f, 0.032f, glm::vec3(1.0f), glm::vec3(1.0f), glm::vec3(1.0f) };
+			sceneLights.push_back(light);
+		}
+		// Shaders compile on driver threads while the models are imported
+		requestShaders();
+
+		// Vertex cache efficiency of every asset, including the factories the scene does not load
+		const char * assets[] = {
+			"C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/factory1/factory1.obj",
+			"C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/factory2/factory2.obj",
+			"C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/factory3/factory3.obj",
+			"C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/factory4/factory4.obj",
+			"C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/co2/co2.obj",
+			"C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/o2/o2.obj",
+		};
+		for (int i = 0; meshStats && i < 6; i++)
+			Model::reportVertexCache(assets[i]);
 
 		factory = new Model("C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/factory1/factory1.obj");
 		co2 = new Model("C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/co2/co2.obj");
 		o2 = new Model("C:/Users/tiyang/Desktop/CSE190Proj1VR/Minimal/assets/o2/o2.obj");
+		co2Impostor = new MoleculeImpostor(co2);
+		o2Impostor = new MoleculeImpostor(o2);
+		clusteredLights = new ClusteredLights();
 		l_line = new Line();
 		r_line = new Line();
 		l_line_mt = new MatrixTransform(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.0f)));
@@ -642,9 +1002,15 @@ public:
 		last_co2_time = time(0);
 	}
 
+	// Advances the game one frame. Only runs while the simulation does, so nothing spawns during a pause.
 	bool update() {
 		bool hit = false;
 		if (isPlaying) {
+			time_t cur_time = time(0);
+			if (difftime(cur_time, last_co2_time) >= 1.4) {
+				last_co2_time = cur_time;
+				create_co2(false);
+			}
 			auto it = (co2Group->children).begin();
 			while (it != co2Group->children.end()) {
 				bool left_collide = check(l_line, left_transf, it);
@@ -659,6 +1025,7 @@ public:
 					tmp->addChild(o2);
 					o2Group->addChild(tmp);
 					co2Group->children.erase(it++);
+					captures++;
 					hit = true;
 				}
 				else ++it;
@@ -700,6 +1067,7 @@ public:
 		glClearColor(0.0f, 0.0f, 128.0f / 255.0f, 1.0f);
 
 		isPlaying = true;
+		captures = 0;
 
 		for (int i = 0; i < 5; i++) {
 			create_co2(true);
@@ -707,67 +1075,277 @@ public:
 		last_co2_time = time(0);
 	}
 
-	void render(const mat4 & projection, const mat4 & modelview) {
-		// Use the shader of programID
-		glUseProgram(shaderProgram);
-
-		time_t cur_time = time(0);
-		double seconds = difftime(cur_time, last_co2_time);
-		if (seconds >= 1.4 && isPlaying) {
-			last_co2_time = cur_time;
-			create_co2(false);
-		}
-
-		// light
-		glm::vec3 pointLightPosition;
-		pointLightPosition = glm::vec3(10.0f, 10.0f, 5.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[0].position"), pointLightPosition.x, pointLightPosition.y, pointLightPosition.z);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[0].ambient"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[0].diffuse"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[0].specular"), 1.0f, 1.0f, 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[0].constant"), 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[0].linear"), 0.09f); // 0.09
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[0].quadratic"), 0.032f); // 0.032
-
-		
-		pointLightPosition = glm::vec3(10.0f, 10.0f, -20.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[1].position"), pointLightPosition.x, pointLightPosition.y, pointLightPosition.z);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[1].ambient"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[1].diffuse"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[1].specular"), 1.0f, 1.0f, 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[1].constant"), 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[1].linear"), 0.09f); // 0.09
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[1].quadratic"), 0.032f); // 0.032
-
-		pointLightPosition = glm::vec3(-10.0f, 10.0f, 5.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[2].position"), pointLightPosition.x, pointLightPosition.y, pointLightPosition.z);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[2].ambient"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[2].diffuse"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[2].specular"), 1.0f, 1.0f, 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[2].constant"), 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[2].linear"), 0.09f); // 0.09
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[2].quadratic"), 0.032f); // 0.032
-
-		pointLightPosition = glm::vec3(-10.0f, 10.0f, -20.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[3].position"), pointLightPosition.x, pointLightPosition.y, pointLightPosition.z);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[3].ambient"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[3].diffuse"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(shaderProgram, "pointLight[3].specular"), 1.0f, 1.0f, 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[3].constant"), 1.0f);
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[3].linear"), 0.09f); // 0.09
-		glUniform1f(glGetUniformLocation(shaderProgram, "pointLight[3].quadratic"), 0.032f); // 0.032
-		
-
-		factory_mt->draw(glm::mat4(1.0f), shaderProgram, projection, modelview);
-		co2Group->draw(glm::mat4(1.0f), shaderProgram, projection, modelview);
-		o2Group->draw(glm::mat4(1.0f), shaderProgram, projection, modelview);
+	// Draws every combination of the pass toggles once, with a crowd of CO2 and O2 molecules larger than
+	// the overflow spawn, so the driver's first-use work (programs specialised for the state they meet,
+	// buffer and texture residency, instance buffers at their largest) is done before the first real
+	// frame. Draws into whatever framebuffer and viewport are bound, and leaves the game as it was.
+	int warmUp(const mat4 & projection, const mat4 & view) {
+		bool toggles[4] = { useImpostors, depthPrepass, overdrawMode, clusteredLighting };
+		bool playing = isPlaying;
+		// No spawning from render() while warming up
+		isPlaying = false;
+
+		std::vector<MatrixTransform*> crowd;
+		for (int i = 0; i < 110; i++) {
+			create_co2(true);
+			crowd.push_back(dynamic_cast<MatrixTransform*> (co2Group->children.back()));
+			MatrixTransform * mt = new MatrixTransform(crowd.back()->M);
+			mt->addChild(o2);
+			o2Group->addChild(mt);
+			crowd.push_back(mt);
+		}
+
+		int passes = 0;
+		for (int combination = 0; combination < 16; combination++) {
+			useImpostors = (combination & 1) != 0;
+			depthPrepass = (combination & 2) != 0;
+			overdrawMode = (combination & 4) != 0;
+			clusteredLighting = (combination & 8) != 0;
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			render(projection, view, ovrEye_Left);
+			passes++;
+		}
+
+		// Only the crowd's transforms are freed; the co2 and o2 Models below them belong to the scene
+		for (size_t i = 0; i < crowd.size(); i++) {
+			co2Group->removeChild(crowd[i]);
+			o2Group->removeChild(crowd[i]);
+			delete crowd[i];
+		}
+		useImpostors = toggles[0];
+		depthPrepass = toggles[1];
+		overdrawMode = toggles[2];
+		clusteredLighting = toggles[3];
+		isPlaying = playing;
+		last_co2_time = time(0);
+		return passes;
+	}
+
+	void render(const mat4 & projection, const mat4 & modelview, int eye) {
+		std::vector<DrawItem> opaque = opaqueDrawList(modelview);
+
+		if (depthPrepass) {
+			// Lay down depth only, then shade exactly the fragments that survived it
+			// The shading pass below counts these triangles
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			Lod::counting = false;
+			drawItems(opaque, DEPTH_FRAGMENT_SHADER, 0, false, projection, modelview);
+			Lod::counting = true;
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
+
+		if (overdrawMode) {
+			beginOverdrawQuery(eye);
+			GLState::setEnabled(GL_BLEND, true);
+			glBlendFunc(GL_ONE, GL_ONE);
+			drawItems(opaque, OVERDRAW_FRAGMENT_SHADER, 0, false, projection, modelview);
+		}
+		else if (clusteredLighting) {
+			updateClusteredLights(projection, modelview);
+			drawItems(opaque, FRAGMENT_SHADER2, ShaderCache::CLUSTERED, true, projection, modelview);
+		}
+		else {
+			drawItems(opaque, FRAGMENT_SHADER2, 0, true, projection, modelview);
+		}
+
+		if (depthPrepass) {
+			glDepthFunc(GL_LEQUAL);
+			glDepthMask(GL_TRUE);
+		}
+
+		// Atoms are lit by the same lights as the meshes, so they take the clustered variant whenever the meshes
+		// did, and count towards the overdraw picture in its flat colour like the meshes
+		unsigned int impostorFeatures = overdrawMode ? ShaderCache::OVERDRAW : clusteredLighting ? ShaderCache::CLUSTERED : 0;
+		GLint impostorProgram = useImpostors ? ShaderCache::get(IMPOSTOR_VERTEX_SHADER, IMPOSTOR_FRAGMENT_SHADER, impostorFeatures, (int)sceneLights.size()) : 0;
+		if (impostorProgram) {
+			// Impostor quads write their own depth, so they stay out of the pre-pass
+			GLState::setEnabled(GL_CULL_FACE, false);
+			setupPass(impostorProgram, impostorFeatures, modelview);
+			std::vector<glm::mat4> co2Instances = instances(co2Group);
+			std::vector<glm::mat4> o2Instances = instances(o2Group);
+			co2Impostor->drawAtoms(co2Instances, impostorProgram, projection, modelview);
+			o2Impostor->drawAtoms(o2Instances, impostorProgram, projection, modelview);
+		}
+
+		if (overdrawMode) {
+			GLState::setEnabled(GL_BLEND, false);
+			endOverdrawQuery(eye);
+		}
+
+		// The lasers are a flat colour, so they skip normals and lighting entirely
+		GLint lineProgram = ShaderCache::get(VERTEX_SHADER2, FRAGMENT_SHADER2, ShaderCache::UNLIT);
+		if (!lineProgram) return;
+		GLState::useProgram(lineProgram);
 		l_line->pressed = leftHandTriggerPressed;
 		r_line->pressed = rightHandTriggerPressed;
-		l_line_mt->draw(left_transf, shaderProgram, projection, modelview);
-		r_line_mt->draw(right_transf, shaderProgram, projection, modelview);
+		l_line_mt->draw(left_transf, lineProgram, projection, modelview);
+		r_line_mt->draw(right_transf, lineProgram, projection, modelview);
+	}
+
+	// Submits every variant the scene's passes and toggles can draw with. Variants that depend on loaded
+	// materials (TEXTURED) are left to compile on first use.
+	void requestShaders() {
+		int lights = (int)sceneLights.size();
+		unsigned int itemFeatures[2] = { 0, ShaderCache::INSTANCED };
+		for (int i = 0; i < 2; i++) {
+			ShaderCache::request(VERTEX_SHADER2, FRAGMENT_SHADER2, itemFeatures[i], lights);
+			ShaderCache::request(VERTEX_SHADER2, FRAGMENT_SHADER2, itemFeatures[i] | ShaderCache::CLUSTERED, lights);
+			ShaderCache::request(VERTEX_SHADER2, DEPTH_FRAGMENT_SHADER, itemFeatures[i], 0);
+			ShaderCache::request(VERTEX_SHADER2, OVERDRAW_FRAGMENT_SHADER, itemFeatures[i], 0);
+		}
+		ShaderCache::request(VERTEX_SHADER2, FRAGMENT_SHADER2, ShaderCache::UNLIT);
+		ShaderCache::request(IMPOSTOR_VERTEX_SHADER, IMPOSTOR_FRAGMENT_SHADER, 0, lights);
+		ShaderCache::request(IMPOSTOR_VERTEX_SHADER, IMPOSTOR_FRAGMENT_SHADER, ShaderCache::CLUSTERED, lights);
+		ShaderCache::request(IMPOSTOR_VERTEX_SHADER, IMPOSTOR_FRAGMENT_SHADER, ShaderCache::OVERDRAW, 0);
+	}
+
+	// The pointLight uniform array used by the non-clustered variants of shader2.frag and impostor.frag.
+	// sceneLights are in world space and the shaders light in view space, as ClusteredLights does, so the
+	// positions go through this eye's view; the other members are the same every time and GLState skips them.
+	void setupLights(GLint program, const mat4 & view) {
+		GLState::useProgram(program);
+		// GLState caches uniforms by name address, so the names are built once and kept
+		static const char * members[7] = { "position", "ambient", "diffuse", "specular", "constant", "linear", "quadratic" };
+		while (lightUniforms.size() < sceneLights.size() * 7) {
+			size_t i = lightUniforms.size();
+			lightUniforms.push_back("pointLight[" + std::to_string(i / 7) + "]." + members[i % 7]);
+		}
+		for (int i = 0; i < (int)sceneLights.size(); i++) {
+			const PointLight & light = sceneLights[i];
+			const std::string * name = &lightUniforms[i * 7];
+			glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+			GLState::uniform3f(name[0].c_str(), position.x, position.y, position.z);
+			GLState::uniform3f(name[1].c_str(), light.ambient.x, light.ambient.y, light.ambient.z);
+			GLState::uniform3f(name[2].c_str(), light.diffuse.x, light.diffuse.y, light.diffuse.z);
+			GLState::uniform3f(name[3].c_str(), light.specular.x, light.specular.y, light.specular.z);
+			GLState::uniform1f(name[4].c_str(), light.constant);
+			GLState::uniform1f(name[5].c_str(), light.linear);
+			GLState::uniform1f(name[6].c_str(), light.quadratic);
+		}
+	}
+
+	// Rebuilds the clustered light list (scene lights plus one per O2 molecule) and bins it for this eye
+	void updateClusteredLights(const mat4 & projection, const mat4 & modelview) {
+		clusteredLights->lights = sceneLights;
+		if (glowingO2) {
+			for (auto it = o2Group->children.begin(); it != o2Group->children.end(); ++it) {
+				PointLight glow = { glm::vec3((dynamic_cast<MatrixTransform*> (*it))->M[3]), 1.0f, 0.0f, 20.0f,
+					glm::vec3(0.0f), glm::vec3(1.0f, 0.35f, 0.25f), glm::vec3(0.5f) };
+				clusteredLights->lights.push_back(glow);
+			}
+		}
+		clusteredLights->update(projection, modelview, 0.01f, 1000.0f);
+	}
+
+	// Lights whichever variant a lit pass has just switched to
+	void setupPass(GLint program, unsigned int passFeatures, const mat4 & view) {
+		if (passFeatures & ShaderCache::OVERDRAW) return;
+		if (passFeatures & ShaderCache::CLUSTERED) clusteredLights->bind(program);
+		else setupLights(program, view);
 	}
 
 private:
+	struct DrawItem {
+		MatrixTransform * transform;
+		MoleculeImpostor * impostor; // when set, the impostor's bonds are drawn once per entry in instances
+		std::vector<glm::mat4> instances;
+		unsigned int features; // ShaderCache features the item needs on top of the pass's own
+		float distance;
+	};
+
+	// Opaque scene objects, nearest first so early depth testing rejects as much as possible.
+	// With impostors on, the bonds of a whole group are one instanced item at its nearest molecule's distance.
+	std::vector<DrawItem> opaqueDrawList(const mat4 & view) {
+		std::vector<DrawItem> items;
+		DrawItem factoryItem = { factory_mt, nullptr, std::vector<glm::mat4>(), factory->shaderFeatures(), 0.0f };
+		items.push_back(factoryItem);
+		if (useImpostors) {
+			addBondItem(items, co2Impostor, co2Group, view);
+			addBondItem(items, o2Impostor, o2Group, view);
+		}
+		else {
+			for (auto it = co2Group->children.begin(); it != co2Group->children.end(); ++it) {
+				DrawItem item = { dynamic_cast<MatrixTransform*> (*it), nullptr, std::vector<glm::mat4>(), co2->shaderFeatures(), 0.0f };
+				items.push_back(item);
+			}
+			for (auto it = o2Group->children.begin(); it != o2Group->children.end(); ++it) {
+				DrawItem item = { dynamic_cast<MatrixTransform*> (*it), nullptr, std::vector<glm::mat4>(), o2->shaderFeatures(), 0.0f };
+				items.push_back(item);
+			}
+		}
+		for (size_t i = 0; i < items.size(); i++)
+			if (items[i].transform) items[i].distance = -(view * items[i].transform->M)[3].z;
+		std::sort(items.begin(), items.end(), [](const DrawItem & a, const DrawItem & b) {
+			return a.distance < b.distance;
+		});
+		return items;
+	}
+
+	void addBondItem(std::vector<DrawItem> & items, MoleculeImpostor * impostor, Group * group, const mat4 & view) {
+		DrawItem item = { nullptr, impostor, instances(group), ShaderCache::INSTANCED, FLT_MAX };
+		if (item.instances.empty() || impostor->bonds.empty()) return;
+		for (size_t i = 0; i < item.instances.size(); i++)
+			item.distance = std::min(item.distance, -(view * item.instances[i])[3].z);
+		items.push_back(item);
+	}
+
+	// Draws the items with the variant of fragmentName each one needs, switching programs only when that changes.
+	// Depth-only and overdraw passes keep just the features that affect the vertex stage.
+	void drawItems(const std::vector<DrawItem> & items, const char * fragmentName, unsigned int passFeatures, bool lit, const mat4 & projection, const mat4 & modelview) {
+		GLint current = 0;
+		for (size_t i = 0; i < items.size(); i++) {
+			const DrawItem & item = items[i];
+			unsigned int features = passFeatures | (lit ? item.features : (item.features & ShaderCache::INSTANCED));
+			GLint program = ShaderCache::get(VERTEX_SHADER2, fragmentName, features, lit ? (int)sceneLights.size() : 0);
+			if (!program) continue;
+			if (program != current) {
+				GLState::useProgram(program);
+				if (lit) setupPass(program, passFeatures, modelview);
+				current = program;
+			}
+			if (item.impostor) item.impostor->drawBonds(item.instances, program, projection, modelview);
+			else item.transform->draw(glm::mat4(1.0f), program, projection, modelview);
+		}
+	}
+
+	// Counts fragments that pass the depth test while shading, read back a frame later to avoid a stall
+	void beginOverdrawQuery(int eye) {
+		if (!overdrawQueries[0]) glGenQueries(3, overdrawQueries);
+		GLuint query = overdrawQueries[eye];
+		if (overdrawQueryPending[eye]) {
+			GLuint available = 0;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) return;
+			GLuint samples = 0;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+			GLint vp[4];
+			glGetIntegerv(GL_VIEWPORT, vp);
+			overdrawRatio[eye] = (float)samples / (float)(vp[2] * vp[3]);
+			overdrawQueryPending[eye] = false;
+			if (eye == 0 && ++overdrawReports % 90 == 0)
+				std::cout << "Overdraw: " << overdrawRatio[0] << " / " << overdrawRatio[1] << " / " << overdrawRatio[2] << " shaded fragments per pixel (left / right / mono)" << std::endl;
+		}
+		glBeginQuery(GL_SAMPLES_PASSED, query);
+		overdrawQueryActive = true;
+	}
+
+	void endOverdrawQuery(int eye) {
+		if (!overdrawQueryActive) return;
+		glEndQuery(GL_SAMPLES_PASSED);
+		overdrawQueryActive = false;
+		overdrawQueryPending[eye] = true;
+	}
+
+	// World transforms of the molecules in a group, for drawing them as impostors
+	std::vector<glm::mat4> instances(Group * group) {
+		std::vector<glm::mat4> result;
+		for (auto it = group->children.begin(); it != group->children.end(); ++it)
+			result.push_back((dynamic_cast<MatrixTransform*> (*it))->M);
+		return result;
+	}
+
 	void create_co2(bool first_create) {
 		std::uniform_real_distribution<float> plus_minus_one_dist(-1.0, 1.0);
 		std::uniform_real_distribution<float> plus_one_dist(0.0, 1.0);
@@ -785,9 +1363,18 @@ private:
 
 class SimApp : public RiftApp {
 	std::shared_ptr<SimScene> simScene;
+	Haptics haptics;
+	// Buzz played on both hands for every captured molecule
+	std::vector<float> captureBuzz[Haptics::HANDS];
+	bool wasPlaying = true;
+	bool warmUpEnabled;
+	bool meshStats;
+	InputSampler input;
+	// Trigger state as of the last event drained from input
+	bool triggerHeld[ovrHand_Count] = { false, false };
 
 public:
-	SimApp() {}
+	SimApp(bool warmUp = true, bool meshStats = false) : warmUpEnabled(warmUp), meshStats(meshStats) {}
 protected:
 	bool leftHandTriggerPressed = false;
 	bool rightHandTriggerPressed = false;
@@ -803,53 +1390,185 @@ protected:
 		// Set polygon drawing mode to fill front and back of each polygon
 		// You can also use the paramter of GL_LINE instead of GL_FILL to see wireframes
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		// Disable backface culling to render both sides of polygons
-		glDisable(GL_CULL_FACE);
+		// Backface culling is enabled per mesh, only for closed meshes
+		GLState::setEnabled(GL_CULL_FACE, false);
 		// Set clear color
 		glClearColor(0.0f, 0.0f, 128.0f / 255.0f, 1.0f);
 		ovr_RecenterTrackingOrigin(_session);
-		simScene = std::shared_ptr<SimScene>(new SimScene());
+		simScene = std::shared_ptr<SimScene>(new SimScene(meshStats));
+		haptics.init(_session);
+		captureBuzz[ovrHand_Left] = haptics.fade(ovrHand_Left, 0.12f, 1.0f);
+		captureBuzz[ovrHand_Right] = haptics.fade(ovrHand_Right, 0.12f, 1.0f);
+		input.start(_session);
+		if (warmUpEnabled) warmUp();
+		else std::cout << "Warm-up skipped" << std::endl;
+	}
+
+	// Runs the scene's warm-up into a throwaway offscreen target before the first frame is submitted
+	void warmUp() {
+		double start = ovr_GetTimeInSeconds();
+		// Let the texture workers finish, so the warm-up draws real texture layers rather than the placeholder
+		while ((TextureCache::pending() || ShaderCache::pending()) && ovr_GetTimeInSeconds() - start < 5.0) {
+			TextureCache::update();
+			ShaderCache::poll();
+			Sleep(1);
+		}
+		double loaded = ovr_GetTimeInSeconds();
+
+		const GLsizei size = 512;
+		GLuint fbo, renderbuffers[2];
+		glGenFramebuffers(1, &fbo);
+		glGenRenderbuffers(2, renderbuffers);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		// The swap chain's format, so programs are not specialised again for the real eye buffers
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, size, size);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, size, size);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+		glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		glViewport(0, 0, size, size);
+
+		// Wide enough from the origin to take in the factory and the whole spawn volume
+		Lod::currentView = ovrEye_Left;
+		// Variants the scene never requested link here, not in the first frames
+		ShaderCache::blocking = true;
+		int passes = simScene->warmUp(glm::perspective(glm::radians(120.0f), 1.0f, 0.01f, 1000.0f), glm::mat4(1.0f));
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteRenderbuffers(2, renderbuffers);
+		// Then the eye-level passes, through the same path as a real frame
+		int frames = warmUpEyes();
+		ShaderCache::blocking = false;
+		// Make the driver do the deferred work now rather than during the first frames
+		glFinish();
+
+		double end = ovr_GetTimeInSeconds();
+		std::cout << "Warm-up: " << (loaded - start) * 1000.0 << " ms waiting for textures and shaders, " << passes
+			<< " scene passes and " << frames << " eye frames in " << (end - loaded) * 1000.0 << " ms" << std::endl;
 	}
 
 	void shutdownGl() override {
+		input.stop();
 		simScene.reset();
+		ShaderCache::clear();
+		TextureCache::clear();
+		RiftApp::shutdownGl();
 	}
 
-	void update() override {
-		ovr_SetControllerVibration(_session, ovrControllerType_LTouch, 1.0f, 0.0f);
-		ovr_SetControllerVibration(_session, ovrControllerType_RTouch, 1.0f, 0.0f);
-		bool hit = simScene->update();
-		if (hit) {
-			ovr_SetControllerVibration(_session, ovrControllerType_LTouch, 1.0f, 1.0f);
-			ovr_SetControllerVibration(_session, ovrControllerType_RTouch, 1.0f, 1.0f);
+	void onKey(int key, int scancode, int action, int mods) override {
+		if (GLFW_PRESS == action) switch (key) {
+		case GLFW_KEY_I:
+			simScene->useImpostors = !simScene->useImpostors;
+			return;
+		case GLFW_KEY_P:
+			simScene->depthPrepass = !simScene->depthPrepass;
+			return;
+		case GLFW_KEY_O:
+			simScene->overdrawMode = !simScene->overdrawMode;
+			return;
+		case GLFW_KEY_L:
+			simScene->clusteredLighting = !simScene->clusteredLighting;
+			return;
+		case GLFW_KEY_G:
+			simScene->glowingO2 = !simScene->glowingO2;
+			return;
 		}
 
-		double displayMidpointSeconds = ovr_GetPredictedDisplayTime(_session, frame);
-		ovrTrackingState trackState = ovr_GetTrackingState(_session, displayMidpointSeconds, ovrTrue);
+		RiftApp::onKey(key, scancode, action, mods);
+	}
 
-		// determine whether left hand trigger pressed
-		ovrInputState inputState;
+	// Nothing reads the controllers during a pause, so the sampler thread and its 1 ms timer are parked.
+	// Input from before the pause is dropped, so a stale press cannot reset the game on resume.
+	void onPause(bool paused) override {
+		if (paused) {
+			input.stop();
+			return;
+		}
+		InputEvent event;
+		while (input.poll(event)) {}
+		triggerHeld[ovrHand_Left] = triggerHeld[ovrHand_Right] = false;
+		// The spawn clock ran on during the pause; restart it
+		simScene->last_co2_time = time(0);
+		input.start(_session);
+	}
 
-		if (OVR_SUCCESS(ovr_GetInputState(_session, ovrControllerType_Touch, &inputState))) {
-			if (inputState.Buttons) {
+	void update() override {
+		if (frame % 90 == 0 && frame > 0) {
+			if (reportingStats()) {
+				std::cout << "GL state: " << GLState::elided << " of " << GLState::issued + GLState::elided << " binds and uniform writes skipped last frame" << std::endl;
+				std::cout << "Haptics: " << haptics.calls << " runtime calls in the last 90 frames" << std::endl;
+				if (input.overflows())
+					std::cout << "Input: " << input.overflows() << " events lost to a full queue" << std::endl;
+			}
+			haptics.resetStats();
+		}
+		GLState::resetStats();
+		Lod::resetStats();
+		ShaderCache::poll();
+		TextureCache::update();
+
+		// A trigger pressed at any point since the last frame counts as held for this one, even if it was
+		// already released again, so quick pulls during a slow frame still capture
+		bool pressedSinceLastFrame[ovrHand_Count] = { false, false };
+		InputEvent event;
+		while (input.poll(event)) {
+			switch (event.type) {
+			case InputEvent::TRIGGER_PRESS:
+				triggerHeld[event.hand] = true;
+				pressedSinceLastFrame[event.hand] = true;
+				break;
+			case InputEvent::TRIGGER_RELEASE:
+				triggerHeld[event.hand] = false;
+				break;
+			case InputEvent::BUTTON_PRESS:
 				simScene->reset();
+				break;
+			default:
+				break;
 			}
+		}
+		simScene->leftHandTriggerPressed = triggerHeld[ovrHand_Left] || pressedSinceLastFrame[ovrHand_Left];
+		simScene->rightHandTriggerPressed = triggerHeld[ovrHand_Right] || pressedSinceLastFrame[ovrHand_Right];
 
-			if (inputState.IndexTrigger[ovrHand_Left] > 0.5f) simScene->leftHandTriggerPressed = true;
-			else simScene->leftHandTriggerPressed = false;
-
-			if (inputState.IndexTrigger[ovrHand_Right] > 0.5f) simScene->rightHandTriggerPressed = true;
-			else simScene->rightHandTriggerPressed = false;
+		bool hit = simScene->update();
+		if (hit) {
+			haptics.submit(ovrHand_Left, captureBuzz[ovrHand_Left]);
+			haptics.submit(ovrHand_Right, captureBuzz[ovrHand_Right]);
 		}
-		ovrPosef leftPose = trackState.HandPoses[ovrHand_Left].ThePose;
-		simScene->left_transf = ovr::toGlm(leftPose);
+		if (wasPlaying && !simScene->isPlaying) {
+			// Three long pulses when the round ends, cleared or overrun
+			std::vector<HapticsPulse> roundOver;
+			for (int i = 0; i < 3; i++) {
+				HapticsPulse on = { 0.2f, 1.0f, 0.8f }, off = { 0.15f, 0.0f, 0.0f };
+				roundOver.push_back(on);
+				roundOver.push_back(off);
+			}
+			haptics.play(ovrHand_Left, roundOver);
+			haptics.play(ovrHand_Right, roundOver);
+		}
+		wasPlaying = simScene->isPlaying;
+		haptics.update();
+	}
+
+	void latchPoses(double displayTime) override {
+		// ovr_GetEyePoses has already set this frame's latency marker
+		ovrTrackingState trackState = ovr_GetTrackingState(_session, displayTime, ovrFalse);
+		simScene->left_transf = ovr::toGlm(trackState.HandPoses[ovrHand_Left].ThePose);
+		simScene->right_transf = ovr::toGlm(trackState.HandPoses[ovrHand_Right].ThePose);
+	}
 
-		ovrPosef rightPose = trackState.HandPoses[ovrHand_Right].ThePose;
-		simScene->right_transf = ovr::toGlm(rightPose);
+	void renderScene(const glm::mat4 & projection, const glm::mat4 & headPose, int view) override {
+		Lod::currentView = view;
+		simScene->render(projection, glm::inverse(headPose), view);
 	}
 
-	void renderScene(const glm::mat4 & projection, const glm::mat4 & headPose) override {
-		simScene->render(projection, glm::inverse(headPose));
+	std::string hudText() override {
+		char text[128];
+		const char* state = simScene->isPlaying ? "" : simScene->co2Group->children.empty() ? "  CLEARED" : "  OVERRUN";
+		snprintf(text, sizeof(text), "CO2 LEFT: %d%s\nCAPTURED: %d\n", (int)simScene->co2Group->children.size(), state, simScene->captures);
+		return text;
 	}
 };
 
@@ -860,7 +1579,13 @@ int __stdcall WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 		if (!OVR_SUCCESS(ovr_Initialize(nullptr))) {
 			FAIL("Failed to initialize the Oculus SDK");
 		}
-		result = SimApp().run();
+		// --no-warmup gives the cold-start numbers to compare the warm-up against;
+		// --mesh-stats logs the vertex cache efficiency of every asset at startup;
+		// --mirror-rate=N refreshes the mirror window, and captures it, N times a second
+		SimApp app(strstr(lpCmdLine, "--no-warmup") == nullptr, strstr(lpCmdLine, "--mesh-stats") != nullptr);
+		const char* mirrorRate = strstr(lpCmdLine, "--mirror-rate=");
+		if (mirrorRate) app.setMirrorRate((float)atof(mirrorRate + strlen("--mirror-rate=")));
+		result = app.run();
 	}
 	catch (std::exception & error) {
 		OutputDebugStringA(error.what());
@@ -0,0 +1,13 @@
+#version 330 core
+
+// Multi-resolution resolve: stretches one packed region back to its place in the eye viewport
+in vec2 TexCoord;
+
+uniform sampler2D source;
+
+out vec4 color;
+
+void main()
+{
+    color = texture(source, TexCoord);
+}
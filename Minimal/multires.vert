@@ -0,0 +1,17 @@
+#version 330 core
+
+// Full-viewport quad straight from gl_VertexID, drawn as a 4-vertex strip with no buffers
+uniform vec4 sourceRect; // uv min in xy, max in zw
+uniform vec2 texelSize;
+
+out vec2 TexCoord;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+    // Keep the bilinear footprint inside the region so its packed neighbours do not bleed in
+    vec2 lo = sourceRect.xy + 0.5f * texelSize;
+    vec2 hi = sourceRect.zw - 0.5f * texelSize;
+    TexCoord = mix(lo, hi, corner);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 color;
+
+// Overdraw visualisation: blended additively, so brightness counts the fragments shaded per pixel
+void main()
+{
+    color = vec4(0.1f, 0.05f, 0.0f, 1.0f);
+}
@@ -4,6 +4,14 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <regex>
+#include <cstring>
+#include <cstdlib>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 using namespace std;
 
 #define GLFW_INCLUDE_GLEXT
@@ -15,109 +23,277 @@ using namespace std;
 #include <GLFW/glfw3.h>
 
 #include "shader.h"
+#include "EmbeddedShaders.h"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+static const std::regex IncludeDirective("^\\s*#\\s*include\\s+\"([^\"]+)\"\\s*$");
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+// Reads a shader file and splices in its #include "file" lines the same way embed_shaders.py does
+static bool ReadShaderFile(const std::string & path, std::string & code, int depth){
+	if (depth > 8) {
+		printf("%s: #include nested too deeply\n", path.c_str());
+		return false;
+	}
+	std::ifstream file(path.c_str(), std::ios::in);
+	if (!file.is_open()) {
+		printf("Impossible to open %s\n", path.c_str());
+		return false;
+	}
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+	std::string Line;
+	std::smatch match;
+	for (int number = 1; getline(file, Line); number++) {
+		if (std::regex_match(Line, match, IncludeDirective)) {
+			code += "#line 1\n";
+			if (!ReadShaderFile(directory + match[1].str(), code, depth + 1)) return false;
+			code += "#line " + std::to_string(number + 1) + "\n";
+		}
+		else code += Line + "\n";
+	}
+	return true;
+}
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Check to make sure the file exists and you passed in the right filepath!\n", vertex_file_path);
-		printf("The current working directory is:");
-		// Please for the love of whatever deity/ies you believe in never do something like the next line of code,
-		// Especially on non-Windows systems where you can have the system happily execute "rm -rf ~"
+// Shaders come from the table generated by embed_shaders.py, unless the SHADER_OVERRIDE_DIR environment
+// variable names a directory to read them from instead (handy while editing shaders)
+static bool ShaderSource(const char * name, std::string & code){
+	std::string overrideDir;
 #ifdef _WIN32
-		system("CD");
+	char * value = NULL;
+	size_t length = 0;
+	if (_dupenv_s(&value, &length, "SHADER_OVERRIDE_DIR") == 0 && value) {
+		overrideDir = value;
+		free(value);
+	}
 #else
-		system("pwd");
+	const char * value = getenv("SHADER_OVERRIDE_DIR");
+	if (value) overrideDir = value;
 #endif
-		getchar();
-		return 0;
+	if (!overrideDir.empty())
+		return ReadShaderFile(overrideDir + "/" + name, code, 0);
+
+	for (size_t i = 0; i < sizeof(embeddedShaders) / sizeof(embeddedShaders[0]); i++) {
+		if (strcmp(embeddedShaders[i].name, name) == 0) {
+			code = embeddedShaders[i].source;
+			return true;
+		}
 	}
+	printf("No embedded shader named %s; rerun embed_shaders.py\n", name);
+	return false;
+}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
+// Inserts the defines after the #version line, followed by a #line so compiler messages keep the same line numbers as without them
+static std::string InjectDefines(const std::string & code, const std::string & defines){
+	if (defines.empty()) return code;
+	size_t version = code.find("#version");
+	size_t lineEnd = (version == std::string::npos) ? std::string::npos : code.find('\n', version);
+	if (lineEnd == std::string::npos) return defines + code;
+	int nextLine = (int)std::count(code.begin(), code.begin() + lineEnd, '\n') + 2;
+	return code.substr(0, lineEnd + 1) + defines + "#line " + std::to_string(nextLine) + "\n" + code.substr(lineEnd + 1);
+}
+
+// 64-bit FNV-1a, enough to tell program sources and drivers apart
+static unsigned long long HashString(const std::string & text, unsigned long long hash = 14695981039346656037ull){
+	for (size_t i = 0; i < text.size(); i++) {
+		hash ^= (unsigned char)text[i];
+		hash *= 1099511628211ull;
 	}
+	return hash;
+}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
+// Cache file for a program: the key covers both sources (defines included) and the driver that built it,
+// so a driver update or a shader edit simply misses instead of loading a stale binary
+static std::string ProgramCachePath(const std::string & vertexCode, const std::string & fragmentCode){
+	std::string driver;
+	const GLubyte * strings[3] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+	for (int i = 0; i < 3; i++)
+		driver += std::string(strings[i] ? (const char *)strings[i] : "") + "\n";
+	unsigned long long hash = HashString(vertexCode);
+	hash = HashString(std::string(1, '\0') + fragmentCode, hash);
+	hash = HashString(std::string(1, '\0') + driver, hash);
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", hash);
+	return std::string(SHADER_CACHE_DIR) + "/" + name;
+}
 
+static bool ProgramBinariesSupported(){
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
 
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
+// Returns a linked program from the cache file, or 0 when there is none or the driver rejects it
+static GLuint LoadProgramBinary(const std::string & path){
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open()) return 0;
+	GLenum format = 0;
+	file.read((char *)&format, sizeof(format));
+	std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (!file.good() && !file.eof()) return 0;
+	if (binary.empty()) return 0;
 
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
-	}
-	else {
-		printf("Successfully compiled vertex shader!\n");
+	GLuint ProgramID = glCreateProgram();
+	glProgramBinary(ProgramID, format, &binary[0], (GLsizei)binary.size());
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE) {
+		printf("Cached program %s was rejected by the driver, recompiling\n", path.c_str());
+		glDeleteProgram(ProgramID);
+		return 0;
 	}
+	return ProgramID;
+}
 
+static void SaveProgramBinary(GLuint ProgramID, const std::string & path){
+	GLint length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(ProgramID, length, NULL, &format, &binary[0]);
 
+#ifdef _WIN32
+	_mkdir(SHADER_CACHE_DIR);
+#else
+	mkdir(SHADER_CACHE_DIR, 0755);
+#endif
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		printf("Could not write program cache %s\n", path.c_str());
+		return;
+	}
+	file.write((const char *)&format, sizeof(format));
+	file.write(&binary[0], binary.size());
+}
 
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRY * PFNMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+// KHR/ARB_parallel_shader_compile: compiles and links run on driver threads and can be polled without blocking
+static bool ParallelCompileSupported(){
+	static int supported = -1;
+	if (supported < 0) {
+		PFNMAXSHADERCOMPILERTHREADSPROC maxThreads = NULL;
+		if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+			maxThreads = (PFNMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+			maxThreads = (PFNMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		supported = maxThreads ? 1 : 0;
+		// 0xFFFFFFFF lets the driver pick its own thread count
+		if (maxThreads) maxThreads(0xFFFFFFFF);
+		printf("Parallel shader compile: %s\n", supported ? "yes" : "no");
+	}
+	return supported == 1;
+}
 
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+// Prints a shader's info log, if it has one
+static void PrintShaderLog(GLuint ShaderID, const std::string & path){
+	int InfoLogLength;
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s:\n%s\n", path.c_str(), &ShaderErrorMessage[0]);
 	}
-	else {
-		printf("Successfully compiled fragment shader!\n");
+}
+
+GLuint LoadShaders(const char * vertex_shader_name,const char * fragment_shader_name){
+	return LoadShaders(vertex_shader_name, fragment_shader_name, std::string());
+}
+
+GLuint LoadShaders(const char * vertex_shader_name, const char * fragment_shader_name, const std::string & defines){
+	ShaderBuild build = SubmitShaders(vertex_shader_name, fragment_shader_name, defines);
+	return FinishShaders(build);
+}
+
+ShaderBuild SubmitShaders(const char * vertex_shader_name, const char * fragment_shader_name, const std::string & defines){
+	ShaderBuild build;
+	build.vertexName = vertex_shader_name;
+	build.fragmentName = fragment_shader_name;
+	build.program = 0;
+	build.vertexShader = 0;
+	build.fragmentShader = 0;
+	build.finished = true;
+
+	std::string VertexShaderCode;
+	std::string FragmentShaderCode;
+	if (!ShaderSource(vertex_shader_name, VertexShaderCode) || !ShaderSource(fragment_shader_name, FragmentShaderCode))
+		return build;
+
+	VertexShaderCode = InjectDefines(VertexShaderCode, defines);
+	FragmentShaderCode = InjectDefines(FragmentShaderCode, defines);
+
+	// A program linked on an earlier run skips compiling and linking entirely
+	if (ProgramBinariesSupported()) {
+		build.cachePath = ProgramCachePath(VertexShaderCode, FragmentShaderCode);
+		build.program = LoadProgramBinary(build.cachePath);
+		if (build.program) return build;
 	}
 
+	// Submit both compiles and the link without asking for any status, so the driver never has to finish one
+	// before the next starts. Errors are collected in FinishShaders.
+	ParallelCompileSupported();
+	printf("Compiling shaders : %s, %s\n", vertex_shader_name, fragment_shader_name);
+	build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	char const * VertexSourcePointer = VertexShaderCode.c_str();
+	glShaderSource(build.vertexShader, 1, &VertexSourcePointer , NULL);
+	glCompileShader(build.vertexShader);
+
+	build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
+	glShaderSource(build.fragmentShader, 1, &FragmentSourcePointer , NULL);
+	glCompileShader(build.fragmentShader);
 
-	// Link the program
-	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
+	build.program = glCreateProgram();
+	glAttachShader(build.program, build.vertexShader);
+	glAttachShader(build.program, build.fragmentShader);
+	if (!build.cachePath.empty()) glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(build.program);
+	build.finished = false;
+	return build;
+}
 
-	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+bool ShaderBuildReady(const ShaderBuild & build){
+	if (build.finished || !ParallelCompileSupported()) return true;
+	GLint Complete = GL_FALSE;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &Complete);
+	return Complete == GL_TRUE;
+}
+
+GLuint FinishShaders(ShaderBuild & build){
+	if (build.finished) return build.program;
+
+	// Check the program; the compile logs only matter when linking failed or the driver had warnings
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	PrintShaderLog(build.vertexShader, build.vertexName);
+	PrintShaderLog(build.fragmentShader, build.fragmentName);
+	glGetProgramiv(build.program, GL_LINK_STATUS, &Result);
+	glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
 		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		glGetProgramInfoLog(build.program, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		printf("%s\n", &ProgramErrorMessage[0]);
 	}
-	
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
-	
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	if (Result != GL_TRUE)
+		printf("Linking %s, %s failed\n", build.vertexName.c_str(), build.fragmentName.c_str());
 
-	return ProgramID;
-}
\ No newline at end of file
+	glDetachShader(build.program, build.vertexShader);
+	glDetachShader(build.program, build.fragmentShader);
+
+	glDeleteShader(build.vertexShader);
+	glDeleteShader(build.fragmentShader);
+	build.vertexShader = 0;
+	build.fragmentShader = 0;
+
+	if (Result != GL_TRUE) {
+		// Nothing can draw with it, so the caller gets 0 rather than a program that only raises GL errors
+		glDeleteProgram(build.program);
+		build.program = 0;
+	}
+	else if (!build.cachePath.empty())
+		SaveProgramBinary(build.program, build.cachePath);
+
+	build.finished = true;
+	return build.program;
+}
@@ -1,6 +1,40 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
+#include <string>
+
+// Shaders are loaded by file name ("shader2.vert") from the sources embedded at build time
+// (EmbeddedShaders.h, generated by embed_shaders.py), or from $SHADER_OVERRIDE_DIR when it is set
+
+// Linked programs are cached here, relative to the working directory, and reused on the next launch
+#define SHADER_CACHE_DIR "shadercache"
+
+GLuint LoadShaders(const char * vertex_shader_name,const char * fragment_shader_name);
+
+// Same as above, with a block of #define lines inserted after the #version line of both sources
+GLuint LoadShaders(const char * vertex_shader_name, const char * fragment_shader_name, const std::string & defines);
+
+// A program whose compile and link have been submitted but not yet checked
+struct ShaderBuild {
+	std::string vertexName;
+	std::string fragmentName;
+	std::string cachePath;
+	GLuint program;
+	GLuint vertexShader;
+	GLuint fragmentShader;
+	bool finished;
+};
+
+// Reads the sources and submits both compiles and the link without waiting for any of them.
+// Programs found in the binary cache come back already finished.
+ShaderBuild SubmitShaders(const char * vertex_shader_name, const char * fragment_shader_name, const std::string & defines);
+
+// True once FinishShaders would not block. Without KHR_parallel_shader_compile this is always true,
+// and the wait happens inside FinishShaders instead.
+bool ShaderBuildReady(const ShaderBuild & build);
+
+// Checks and logs the compile and link results, stores the binary in the cache and returns the program,
+// or deletes it and returns 0 if it failed to link
+GLuint FinishShaders(ShaderBuild & build);
 
 #endif
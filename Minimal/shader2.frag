@@ -2,72 +2,51 @@
 in vec2 TexCoords;
 out vec4 color;
 
-uniform sampler2D texture_diffuse1;
+// Variants are compiled by ShaderCache with TEXTURED, UNLIT, CLUSTERED or NUM_POINT_LIGHTS defined
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 4
+#endif
 
-struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-};
+#ifdef TEXTURED
+// Diffuse maps are layers of TextureCache arrays; diffuseLayer is -1 for untextured meshes of a textured model
+uniform sampler2DArray texture_diffuse;
+uniform int diffuseLayer;
+#endif
 
-struct PointLight {
-    vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    bool enabled;
-};
+#include "lighting.glsl"
 
 in vec3 FragPos;
 in vec3 Normal;
 uniform Material material;
 uniform vec3 viewPos;
-uniform PointLight pointLight[4];
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#if !defined(CLUSTERED) && NUM_POINT_LIGHTS > 0
+uniform PointLight pointLight[NUM_POINT_LIGHTS];
+#endif
 
 void main()
 {
-    // color = texture(texture_diffuse1, TexCoords);
+#ifdef TEXTURED
+    vec3 albedo = material.diffuse;
+    if (diffuseLayer >= 0)
+        albedo *= texture(texture_diffuse, vec3(TexCoords, float(diffuseLayer))).rgb;
+#else
+    vec3 albedo = material.diffuse;
+#endif
+
+#ifdef UNLIT
+    color = vec4(albedo, 1.0);
+#else
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 result = vec3(0.0f, 0.0f, 0.0f);
-    for(int i=0; i<4; i++){
-        result = result + CalcPointLight(pointLight[i], norm, FragPos, viewDir);
+#if defined(CLUSTERED)
+    result = CalcClusteredLights(material, albedo, norm, FragPos, viewDir);
+#elif NUM_POINT_LIGHTS > 0
+    for(int i=0; i<NUM_POINT_LIGHTS; i++){
+        result = result + CalcPointLight(pointLight[i], material, albedo, norm, FragPos, viewDir);
     }
+#endif
     color = vec4(result, 1.0);
-    //color = vec4(material.diffuse.r, material.diffuse.g, material.diffuse.b, 1.0f);
-}
-
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    // Ambient
-    vec3 ambient = light.ambient * material.ambient;
-
-    // Diffuse shading
-    vec3 lightDir = normalize(light.position - fragPos);
-    float diff = max(dot(normal, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-
-    // Specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * spec * material.specular;
-
-    // Attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-
-    // Combine results
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+#endif
 }
@@ -2,6 +2,10 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
+#ifdef INSTANCED
+// Per-instance world matrix, one column per attribute location 3-6
+layout (location = 3) in mat4 instanceWorld;
+#endif
 
 out vec2 TexCoords;
 
@@ -12,10 +16,20 @@ uniform mat4 projection;
 out vec3 Normal;
 out vec3 FragPos;
 
+// The depth pre-pass (depth.frag) and the GL_EQUAL shading pass must produce bit-identical depth
+invariant gl_Position;
+
 void main()
 {
-    gl_Position = projection * model * view * vec4(position, 1.0f);
+#ifdef INSTANCED
+    mat4 world = instanceWorld;
+#else
+    mat4 world = view;
+#endif
+    gl_Position = projection * model * world * vec4(position, 1.0f);
     TexCoords = texCoords;
-    FragPos = vec3(model * view * vec4(position.x, position.y, position.z, 1.0));
-    Normal = mat3(transpose(inverse(model * view))) * normal;
+    FragPos = vec3(model * world * vec4(position.x, position.y, position.z, 1.0));
+#ifndef UNLIT
+    Normal = mat3(transpose(inverse(model * world))) * normal;
+#endif
 }
\ No newline at end of file